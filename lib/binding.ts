@@ -29,7 +29,11 @@ export type CppBytes = string | Buffer
 export type CppDocFlags = number
 export type CppExpiry = number
 
-export type CppJsonString = string | Buffer
+export type CppJsonValue = null | boolean | number | object
+
+// Strings and Uint8Arrays (including Buffers) hold pre-encoded JSON, any
+// other value is serialized to JSON by the binding.
+export type CppJsonString = string | Uint8Array | CppJsonValue
 
 export interface CppClusterCredentials {
   username?: string
@@ -47,6 +51,143 @@ export interface CppClusterSecurityOptions {
   trustOnlyCertificates?: string[]
 }
 
+export interface CppConnectOptions {
+  shareConnection?: boolean
+  hedgeBudget?: number
+  maxBufferedRowBytes?: number
+  slowQueryThreshold?: CppMilliseconds
+  slowQuerySampleRate?: number
+  slowQueryLogSize?: number
+  redactSlowQueries?: boolean
+  maxQueryFingerprints?: number
+}
+
+export interface CppQueryTimings {
+  dispatched?: number
+  firstByte?: number
+  firstRow?: number
+  lastRow?: number
+  finished?: number
+  jsQueued: number
+}
+
+export interface CppSlowQueryRecord {
+  statement: string
+  requestId: string
+  startedAt: number
+  duration: number
+  serverElapsed?: number
+  timings: CppQueryTimings
+  rowCount: number
+  bytes: number
+  error?: string
+  sampled: boolean
+}
+
+export interface CppSlowQueries {
+  records: CppSlowQueryRecord[]
+  overwritten: number
+}
+
+export interface CppStatementStats {
+  fingerprint: string
+  statement: string
+  calls: number
+  errors: number
+  rows: number
+  bytes: number
+  totalTime: number
+  meanTime: number
+  p99Time: number
+}
+
+export interface CppQueryStats {
+  statements: CppStatementStats[]
+  evicted: number
+}
+
+export interface CppMemoryUsage {
+  bytes: number
+  results: number
+}
+
+export interface CppRowBufferUsage {
+  bufferedBytes: number
+  limit: number
+  pausedStreams: number
+}
+
+export interface CppQueryExecOptions {
+  hedge?: boolean
+  hedgeDelay?: CppMilliseconds
+  collectRows?: {
+    keepRows?: number
+    maxBytes?: number
+    drain?: boolean
+  }
+  rowDecoder?: string
+  schema?: CppQueryField[]
+}
+
+export interface CppQueryField {
+  name: string
+  type: string
+  nullable?: boolean
+}
+
+export interface CppCollectedRows {
+  rows: string[]
+  complete: boolean
+}
+
+export interface CppNodeScore {
+  endpoint: string
+  latencyEwma: number
+  failureEwma: number
+  samples: number
+  latencySamples: number
+  score: number
+}
+
+export interface CppWarmupOptions {
+  connectionsPerNode?: number
+  timeout?: CppMilliseconds
+}
+
+export interface CppBulkUpsertOptions {
+  database: string
+  scope: string
+  collection: string
+  batchBytes?: number
+  concurrency?: number
+  maxRetries?: number
+  timeout?: CppMilliseconds
+}
+
+export interface CppBulkUpsertBatch {
+  firstDocument: number
+  documents: number
+  bytes: number
+  attempts: number
+  error: CppColumnarError | null
+}
+
+export interface CppBulkUpsertResult {
+  batches: CppBulkUpsertBatch[]
+  succeeded: number
+  failed: number
+}
+
+export interface CppWarmupNodeResult {
+  endpoint: string
+  handshakeLatencies: number[]
+  errors: string[]
+}
+
+export interface CppWarmupResult {
+  nodes: CppWarmupNodeResult[]
+}
+
 export interface CppDnsConfig {
   nameserver?: string
   port?: number
@@ -57,6 +198,37 @@ export interface CppColumnarQueryResult {
   nextRow(callback: (row: string, err: CppColumnarError | null) => void): void
   cancel(): boolean
   metadata(): CppColumnarQueryMetadata | undefined
+  timings(): CppQueryTimings | null
+  memoryUsage(): number
+  startRowRing(memory: Uint8Array, notify: () => void): void
+  rowRingWait(): boolean
+  rowRingResume(): void
+  rowRingTakeRow(): string
+  rowRingError(): CppColumnarError | null
+  startSpill(path: string, notify: () => void): void
+  spillRead(maxRows: number): string[]
+  spillWait(): boolean
+  spillDone(): boolean
+  spillError(): CppColumnarError | null
+}
+
+export interface CppAsyncLoggingOptions {
+  filename?: string
+  queueSize?: number
+  dropPolicy?: 'drop_newest' | 'drop_oldest'
+  level?: string
+}
+
+export interface CppLogQueueStats {
+  enqueued: number
+  written: number
+  dropped: number
+  queueSize: number
+}
+
+export interface CppLogStats {
+  logger?: CppLogQueueStats
+  protocol?: CppLogQueueStats
 }
 
 // #region Autogenerated Bindings
@@ -73,7 +245,7 @@ export interface CppColumnarTimeoutConfig {
   management_timeout: CppMilliseconds
 }
 export interface CppColumnarQueryOptions {
-  statement: string
+  statement: string | Uint8Array
   database_name?: string
   scope_name?: string
   priority?: boolean
@@ -173,25 +345,60 @@ export interface CppConnection extends CppConnectionAutogen {
     connStr: string,
     credentials: CppClusterCredentials,
     securityOptions: CppClusterSecurityOptions,
-    dnsOptions: CppDnsConfig | null
+    dnsOptions: CppDnsConfig | null,
+    connectOptions: CppConnectOptions
   ): void
 
   shutdown(callback: () => void): void
 
   query(
     options: CppColumnarQueryOptions,
-    callback: (err: CppColumnarError | null) => void
+    callback: (
+      err: CppColumnarError | null,
+      collected?: CppCollectedRows
+    ) => void,
+    execOptions?: CppQueryExecOptions
   ): {
     cppQueryErr: CppColumnarError | null
     cppQueryResult: CppColumnarQueryResult
   }
+
+  bulkUpsert(
+    options: CppBulkUpsertOptions,
+    docs: (Uint8Array | CppJsonValue)[],
+    callback: (err: CppColumnarError | null, result: CppBulkUpsertResult) => void
+  ): void
+
+  warmup(
+    options: CppWarmupOptions,
+    callback: (err: CppColumnarError | null, result: CppWarmupResult) => void
+  ): void
+
+  nodeScores(): CppNodeScore[]
+
+  rowBufferUsage(): CppRowBufferUsage
+
+  slowQueries(): CppSlowQueries
+
+  flushSlowQueries(filename: string): number
+
+  queryStats(): CppQueryStats
+
+  resetQueryStats(): void
+
+  memoryUsage(): CppMemoryUsage
 }
 
 export interface CppBinding extends CppBindingAutogen {
   cbppVersion: string
   cbppMetadata: string
   enableProtocolLogger: (filename: string) => void
+  disableProtocolLogger: () => void
+  enableAsyncLogging: (options: CppAsyncLoggingOptions) => void
+  setLogLevel: (level: string) => void
+  logStats: () => CppLogStats
   shutdownLogger: () => void
+  registerRowDecoder: (decoder: unknown) => string
 
   Connection: {
     new (): CppConnection
@@ -0,0 +1,114 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+import { randomUUID } from 'crypto'
+import { promises as dns } from 'dns'
+import * as fs from 'fs'
+
+const CACHE_VERSION = 1
+
+interface BootstrapCacheEntry {
+  seeds: [string, number][]
+  updatedAt: number
+}
+
+interface BootstrapCacheContents {
+  version: number
+  entries: { [key: string]: BootstrapCacheEntry }
+}
+
+/**
+ * On-disk cache of the seed nodes which a DNS SRV connection string resolved to,
+ * so that later processes can connect to them directly instead of waiting for the
+ * SRV lookup.
+ *
+ * @internal
+ */
+export class BootstrapCache {
+  private _path: string
+  private _ttl: number
+
+  constructor(path: string, ttl: number) {
+    this._path = path
+    this._ttl = ttl
+  }
+
+  /**
+   * Returns the cached seed nodes for the key, unless they are missing or older
+   * than the TTL.  A cache which cannot be read is treated as empty.
+   */
+  get(key: string): [string, number][] | undefined {
+    const entry = this._read().entries[key]
+    if (!entry || Date.now() - entry.updatedAt > this._ttl) {
+      return undefined
+    }
+    return entry.seeds
+  }
+
+  /**
+   * Resolves the SRV records of the host and stores them under the key.
+   */
+  async refresh(
+    key: string,
+    host: string,
+    nameserver?: string,
+    port?: number
+  ): Promise<void> {
+    const resolver = new dns.Resolver()
+    if (nameserver) {
+      resolver.setServers([port ? `${nameserver}:${port}` : nameserver])
+    }
+
+    const records = await resolver.resolveSrv(`_couchbases._tcp.${host}`)
+    if (records.length === 0) {
+      return
+    }
+    records.sort((a, b) => a.priority - b.priority || b.weight - a.weight)
+    const seeds: [string, number][] = records.map((record) => [
+      record.name,
+      record.port,
+    ])
+
+    // the cache is read only now, right before writing it, so that the entries
+    // other clusters or processes stored while this one was resolving are kept
+    const contents = this._read()
+    contents.entries[key] = { seeds, updatedAt: Date.now() }
+
+    // write to a temporary file first so that concurrent readers never see a
+    // partially written cache, every writer uses its own, even within a process
+    const tmpPath = `${this._path}.${process.pid}.${randomUUID()}.tmp`
+    try {
+      await fs.promises.writeFile(tmpPath, JSON.stringify(contents))
+      await fs.promises.rename(tmpPath, this._path)
+    } catch (e) {
+      await fs.promises.rm(tmpPath, { force: true })
+      throw e
+    }
+  }
+
+  private _read(): BootstrapCacheContents {
+    try {
+      const contents = JSON.parse(fs.readFileSync(this._path, 'utf8'))
+      if (contents.version === CACHE_VERSION && contents.entries) {
+        return contents
+      }
+    } catch (e) {
+      // a missing or corrupt cache is simply rebuilt
+    }
+    return { version: CACHE_VERSION, entries: {} }
+  }
+}
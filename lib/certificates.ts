@@ -22,16 +22,25 @@ import * as path from 'path'
  * @internal
  */
 export class Certificates {
+  private static _nonprodCertificates: string[] | undefined
+
   /**
    * @internal
    */
   public static getNonprodCertificates(): string[] {
-    const basePath = path.resolve(path.dirname(__filename), '..')
-    const certPath = path.join(basePath, 'dist', 'nonProdCertificates')
-    const certificates: string[] = []
-    fs.readdirSync(certPath).forEach((fileName) => {
-      certificates.push(fs.readFileSync(path.join(certPath, fileName), 'utf-8'))
-    })
-    return certificates
+    // The certificates are read from disk once per process, every cluster
+    // created afterwards reuses them.
+    if (!Certificates._nonprodCertificates) {
+      const basePath = path.resolve(path.dirname(__filename), '..')
+      const certPath = path.join(basePath, 'dist', 'nonProdCertificates')
+      const certificates: string[] = []
+      fs.readdirSync(certPath).forEach((fileName) => {
+        certificates.push(
+          fs.readFileSync(path.join(certPath, fileName), 'utf-8')
+        )
+      })
+      Certificates._nonprodCertificates = certificates
+    }
+    return [...Certificates._nonprodCertificates]
   }
 }
@@ -21,13 +21,15 @@ import binding, {
   CppClusterSecurityOptions,
   CppConnection,
 } from './binding'
+import { BootstrapCache } from './bootstrapcache'
 import { ConnSpec } from './connspec'
 import { PromiseHelper, NodeCallback } from './utilities'
 import { generateClientString } from './utilities_internal'
 import { Database } from './database'
 import { Deserializer, JsonDeserializer } from './deserializers'
 import { InvalidArgumentError } from './errors'
-import { QueryOptions, QueryResult } from './querytypes'
+import { errorFromCpp } from './bindingutilities'
+import { QueryOptions, QueryResult, QueryTimings } from './querytypes'
 import { QueryExecutor } from './queryexecutor'
 
 /**
@@ -164,6 +166,499 @@ export interface ClusterOptions {
    * Can also be set per-operation with {@link QueryOptions.deserializer}.
    */
   deserializer?: Deserializer
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Specifies whether this cluster may share its underlying connection (IO thread and
+   * HTTP connection pools) with other clusters in the process which were created with
+   * this option and an identical connection string, credential, security options and
+   * DNS config.  The shared connection is closed once the last cluster using it is closed.
+   *
+   * Connections are shared across the whole process, including clusters created from
+   * `worker_threads`.  Each thread still receives the results of its own operations on
+   * its own event loop, which allows row processing to be spread across workers without
+   * opening additional connections to the cluster.
+   *
+   * TLS sessions are not resumed across separate connections, so sharing is also the
+   * way to avoid paying for additional full TLS handshakes when creating more clusters.
+   *
+   * Only clusters which also agree on {@link hedgeBudget} and {@link maxBufferedRowBytes},
+   * which apply to the shared connection as a whole, share it.
+   */
+  shareConnection?: boolean
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Specifies the maximum number of hedged requests (see {@link QueryOptions.hedge}) as a
+   * fraction of all queries issued.  Defaults to 0.05.
+   */
+  hedgeBudget?: number
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Specifies the maximum number of bytes of result rows which may be buffered by the
+   * client, across all queries, before they have been consumed.  Once exceeded, no more
+   * rows are read from the network until the buffered rows have been consumed.  Defaults
+   * to 0, which disables the limit.
+   */
+  maxBufferedRowBytes?: number
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Specifies the duration, in milliseconds, above which a query is recorded in the slow
+   * query log (see {@link Cluster.slowQueries}).  A query is slow when either the time
+   * observed by the client or the elapsed time reported by the server exceeds it.  By
+   * default no queries are recorded for being slow.
+   */
+  slowQueryThreshold?: number
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Specifies the fraction, between 0 and 1, of the queries below the slow query
+   * threshold which are recorded in the slow query log anyway.  Defaults to 0.
+   */
+  slowQuerySampleRate?: number
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Specifies how many records the slow query log holds before overwriting the oldest
+   * ones.  Defaults to 128.
+   */
+  slowQueryLogSize?: number
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Specifies whether the literals of statements are replaced with `?` before they are
+   * recorded in the slow query log.  Defaults to false.
+   */
+  redactSlowQueries?: boolean
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Specifies how many distinct statement shapes are tracked by the query stats (see
+   * {@link Cluster.queryStats}).  Once exceeded, the least recently called shape is
+   * evicted to make room for a new one.  Defaults to 0, which disables the query stats.
+   */
+  maxQueryFingerprints?: number
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Specifies a file in which the seed nodes a DNS SRV connection string resolves to
+   * are cached.  While a fresh cache entry exists, connecting skips the SRV lookup and
+   * bootstraps from the cached nodes, and the entry is refreshed in the background.
+   * The file can be shared by any number of processes.  By default nothing is cached.
+   */
+  bootstrapCacheFile?: string
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Specifies how long an entry of the bootstrap cache (see
+   * {@link ClusterOptions.bootstrapCacheFile}) is used for, specified in milliseconds.
+   * Defaults to 24 hours.
+   */
+  bootstrapCacheTtl?: number
+}
+
+/**
+ * Specifies the options for bulk upserting documents into a collection.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface BulkUpsertOptions {
+  /**
+   * Specifies the maximum size of a single UPSERT statement including its documents, in
+   * bytes.  Documents are grouped into statements of up to this size, a document which
+   * is larger on its own is upserted by itself.  Defaults to 1 MiB.
+   */
+  batchBytes?: number
+
+  /**
+   * Specifies how many statements may be executing at the same time.  Defaults to 4.
+   */
+  concurrency?: number
+
+  /**
+   * Specifies how many times a statement is retried, with an exponential backoff, when
+   * the service rejected it without running it (because it is temporarily unavailable
+   * or overloaded).  Any other failure is reported right away.  Defaults to 2.
+   */
+  maxRetries?: number
+
+  /**
+   * Specifies the timeout for each individual statement, specified in millseconds.
+   */
+  timeout?: number
+}
+
+/**
+ * Contains the outcome of a single statement of a bulk upsert.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface BulkUpsertBatch {
+  /**
+   * The index of the first document of this batch within the upserted documents.
+   */
+  firstDocument: number
+
+  /**
+   * The number of documents in this batch.
+   */
+  documents: number
+
+  /**
+   * The size of the JSON encoded documents of this batch, in bytes.
+   */
+  bytes: number
+
+  /**
+   * The number of times the statement was executed, including retries.
+   */
+  attempts: number
+
+  /**
+   * The error of the last attempt if the batch failed, otherwise null.
+   */
+  error: Error | null
+}
+
+/**
+ * Contains the results of bulk upserting documents into a collection.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface BulkUpsertResult {
+  /**
+   * The per-batch results, in the order of the documents.
+   */
+  batches: BulkUpsertBatch[]
+
+  /**
+   * The number of documents which were upserted.
+   */
+  succeeded: number
+
+  /**
+   * The number of documents which could not be upserted.
+   */
+  failed: number
+}
+
+/**
+ * Specifies the options for warming up the connections of a cluster.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface WarmupOptions {
+  /**
+   * Specifies how many connections should be established to every analytics node
+   * in the current cluster config.  Defaults to 1.
+   */
+  connectionsPerNode?: number
+
+  /**
+   * Specifies the timeout for each individual connection attempt, specified in millseconds.
+   */
+  timeout?: number
+}
+
+/**
+ * Contains the warm-up results of a single analytics node.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface WarmupNodeResult {
+  /**
+   * The remote address of the node.
+   */
+  endpoint: string
+
+  /**
+   * The time taken to connect to and get a response from the node, in milliseconds,
+   * for each successful connection.
+   */
+  handshakeLatencies: number[]
+
+  /**
+   * The errors encountered by each failed connection.
+   */
+  errors: string[]
+}
+
+/**
+ * Contains the results of warming up the connections of a cluster.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface WarmupResult {
+  /**
+   * The per-node results.
+   */
+  nodes: WarmupNodeResult[]
+}
+
+/**
+ * Contains the latency score of a single analytics node.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface NodeScore {
+  /**
+   * The remote address of the node.
+   */
+  endpoint: string
+
+  /**
+   * The exponentially weighted moving average of the node's latency, in milliseconds.
+   */
+  latencyEwma: number
+
+  /**
+   * The exponentially weighted moving average of the node's failure rate, between 0 and 1.
+   */
+  failureEwma: number
+
+  /**
+   * The number of observations the averages are based on.
+   */
+  samples: number
+
+  /**
+   * The number of successful observations the latency average is based on.
+   */
+  latencySamples: number
+
+  /**
+   * The overall score of the node, lower is better.  Infinity for a node which has
+   * only failed so far.
+   */
+  score: number
+}
+
+/**
+ * Describes how many result row bytes are currently buffered by a cluster.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface RowBufferUsage {
+  /**
+   * The number of bytes of result rows which have been received but not yet consumed.
+   */
+  bufferedBytes: number
+
+  /**
+   * The configured limit, see {@link ClusterOptions.maxBufferedRowBytes}.
+   */
+  limit: number
+
+  /**
+   * The number of query results which are currently waiting for buffer space.
+   */
+  pausedStreams: number
+}
+
+/**
+ * A query recorded by the slow query log.  Durations are specified in milliseconds.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface SlowQueryRecord {
+  /**
+   * The statement of the query, redacted if {@link ClusterOptions.redactSlowQueries}
+   * is set.
+   */
+  statement: string
+
+  /**
+   * The request id reported by the server, empty if the query failed before returning
+   * its metadata.
+   */
+  requestId: string
+
+  /**
+   * When the query was issued, in milliseconds since the epoch.
+   */
+  startedAt: number
+
+  /**
+   * The time from issuing the query until its last row was read.
+   */
+  duration: number
+
+  /**
+   * The elapsed time reported by the server.
+   */
+  serverElapsed?: number
+
+  /**
+   * The client side phases of the query.
+   */
+  timings: QueryTimings
+
+  /**
+   * The number of rows which were read.
+   */
+  rowCount: number
+
+  /**
+   * The number of bytes of the rows which were read.
+   */
+  bytes: number
+
+  /**
+   * The error the query failed with, if any.
+   */
+  error?: string
+
+  /**
+   * Whether the query was below the threshold and was recorded by sampling.
+   */
+  sampled: boolean
+}
+
+/**
+ * The contents of the slow query log.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface SlowQueries {
+  /**
+   * The recorded queries, oldest first.
+   */
+  records: SlowQueryRecord[]
+
+  /**
+   * The total number of records which were overwritten before they could be read.
+   */
+  overwritten: number
+}
+
+/**
+ * Aggregate statistics of all the queries sharing a statement shape.  Durations are
+ * specified in milliseconds.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface StatementStats {
+  /**
+   * Identifies the shape of the statement.
+   */
+  fingerprint: string
+
+  /**
+   * The statement with its literals replaced by `?` and its whitespace collapsed.
+   */
+  statement: string
+
+  /**
+   * The number of queries which were executed.
+   */
+  calls: number
+
+  /**
+   * The number of queries which failed.
+   */
+  errors: number
+
+  /**
+   * The total number of rows which were read.
+   */
+  rows: number
+
+  /**
+   * The total number of bytes of the rows which were read.
+   */
+  bytes: number
+
+  /**
+   * The total time spent executing the queries, from issuing them until their last
+   * row was read.
+   */
+  totalTime: number
+
+  /**
+   * The mean time spent executing a query.
+   */
+  meanTime: number
+
+  /**
+   * The 99th percentile of the time spent executing a query, approximated to within
+   * 20%.
+   */
+  p99Time: number
+}
+
+/**
+ * The statistics of the queries executed by a cluster, grouped by statement shape.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface QueryStats {
+  /**
+   * The tracked statement shapes, by descending total time.
+   */
+  statements: StatementStats[]
+
+  /**
+   * The number of statement shapes which were evicted to make room for others.
+   */
+  evicted: number
+}
+
+/**
+ * The native memory held by a cluster's connection, outside of the JavaScript heap.
+ * It is also reported to the JavaScript engine, so that the garbage collector can take
+ * it into account.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface NativeMemoryUsage {
+  /**
+   * The number of bytes held for the query results of this cluster, such as rows which
+   * have been received but not yet consumed.
+   */
+  bytes: number
+
+  /**
+   * The number of query results which are still alive.
+   */
+  results: number
 }
 
 /**
@@ -186,6 +681,15 @@ export class Cluster {
   private _conn: CppConnection
   private _dnsConfig: DnsConfig | null
   private _deserializer: Deserializer
+  private _shareConnection: boolean
+  private _hedgeBudget: number | undefined
+  private _maxBufferedRowBytes: number | undefined
+  private _slowQueryThreshold: number | undefined
+  private _slowQuerySampleRate: number | undefined
+  private _slowQueryLogSize: number | undefined
+  private _redactSlowQueries: boolean
+  private _maxQueryFingerprints: number | undefined
+  private _bootstrapCache: BootstrapCache | undefined
 
   /**
    * @internal
@@ -277,6 +781,53 @@ export class Cluster {
     this._connectTimeout = options.timeoutOptions?.socketConnectTimeout
     this._resolveTimeout = options.timeoutOptions?.resolveTimeout
     this._deserializer = options.deserializer || new JsonDeserializer()
+    this._shareConnection = options.shareConnection || false
+    this._hedgeBudget = options.hedgeBudget
+    if (this._hedgeBudget !== undefined && this._hedgeBudget < 0) {
+      throw new Error('hedgeBudget must be non-negative.')
+    }
+    this._maxBufferedRowBytes = options.maxBufferedRowBytes
+    if (
+      this._maxBufferedRowBytes !== undefined &&
+      this._maxBufferedRowBytes < 0
+    ) {
+      throw new Error('maxBufferedRowBytes must be non-negative.')
+    }
+    this._slowQueryThreshold = options.slowQueryThreshold
+    if (
+      this._slowQueryThreshold !== undefined &&
+      this._slowQueryThreshold < 0
+    ) {
+      throw new Error('slowQueryThreshold must be non-negative.')
+    }
+    this._slowQuerySampleRate = options.slowQuerySampleRate
+    if (
+      this._slowQuerySampleRate !== undefined &&
+      (this._slowQuerySampleRate < 0 || this._slowQuerySampleRate > 1)
+    ) {
+      throw new Error('slowQuerySampleRate must be between 0 and 1.')
+    }
+    this._slowQueryLogSize = options.slowQueryLogSize
+    if (this._slowQueryLogSize !== undefined && this._slowQueryLogSize < 0) {
+      throw new Error('slowQueryLogSize must be non-negative.')
+    }
+    this._redactSlowQueries = options.redactSlowQueries || false
+    this._maxQueryFingerprints = options.maxQueryFingerprints
+    if (
+      this._maxQueryFingerprints !== undefined &&
+      this._maxQueryFingerprints < 0
+    ) {
+      throw new Error('maxQueryFingerprints must be non-negative.')
+    }
+    if (options.bootstrapCacheTtl && options.bootstrapCacheTtl < 0) {
+      throw new Error('bootstrapCacheTtl must be non-negative.')
+    }
+    if (options.bootstrapCacheFile) {
+      this._bootstrapCache = new BootstrapCache(
+        options.bootstrapCacheFile,
+        options.bootstrapCacheTtl ?? 24 * 60 * 60 * 1000
+      )
+    }
 
     this._credential = credential
 
@@ -325,11 +876,12 @@ export class Cluster {
   /**
    * Executes a query against the Columnar cluster.
    *
-   * @param statement The columnar SQL++ statement to execute.
+   * @param statement The columnar SQL++ statement to execute, either as a string or as
+   *  UTF-8 encoded bytes.
    * @param options Optional parameters for this operation.
    */
   executeQuery(
-    statement: string,
+    statement: string | Uint8Array,
     options?: QueryOptions
   ): Promise<QueryResult> {
     if (!options) {
@@ -344,6 +896,213 @@ export class Cluster {
     return exec.query(statement, options)
   }
 
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Upserts documents into a collection, grouping them into multi-row UPSERT statements
+   * of bounded size which are executed with bounded concurrency.  The documents of each
+   * statement are passed as a parameter, never as part of the statement text.  Statements
+   * which the service rejected without running them are retried after a backoff.  The
+   * returned promise only rejects if the upsert could not be started, the documents which
+   * could not be upserted are reported through the batches of the result.
+   *
+   * @param databaseName The name of the database.
+   * @param scopeName The name of the scope.
+   * @param collectionName The name of the collection.
+   * @param docs The documents to upsert, Buffers and Uint8Arrays are taken to already
+   *  hold a JSON encoded object each.
+   * @param options Optional parameters for this operation.
+   * @param callback A node-style callback to be invoked after execution.
+   */
+  async bulkUpsert(
+    databaseName: string,
+    scopeName: string,
+    collectionName: string,
+    docs: any[],
+    options?: BulkUpsertOptions,
+    callback?: NodeCallback<BulkUpsertResult>
+  ): Promise<BulkUpsertResult> {
+    return PromiseHelper.wrap((wrapCallback) => {
+      // validation errors are delivered through the callback as well
+      if (!options) {
+        options = {}
+      }
+
+      for (const name of [databaseName, scopeName, collectionName]) {
+        if (typeof name !== 'string' || name.length === 0 || name.includes('`')) {
+          throw new InvalidArgumentError(
+            'Database, scope and collection names must be non-empty and must not contain backticks.'
+          )
+        }
+      }
+      if (!Array.isArray(docs)) {
+        throw new InvalidArgumentError('docs must be an array.')
+      }
+      if (
+        options.batchBytes !== undefined &&
+        (!Number.isInteger(options.batchBytes) || options.batchBytes < 1)
+      ) {
+        throw new InvalidArgumentError('batchBytes must be a positive integer.')
+      }
+      if (
+        options.concurrency !== undefined &&
+        (!Number.isInteger(options.concurrency) || options.concurrency < 1)
+      ) {
+        throw new InvalidArgumentError('concurrency must be a positive integer.')
+      }
+      if (
+        options.maxRetries !== undefined &&
+        (!Number.isInteger(options.maxRetries) || options.maxRetries < 0)
+      ) {
+        throw new InvalidArgumentError('maxRetries must be a non-negative integer.')
+      }
+      if (options.timeout && options.timeout < 0) {
+        throw new Error('timeout must be non-negative.')
+      }
+
+      const cppOptions = {
+        database: databaseName,
+        scope: scopeName,
+        collection: collectionName,
+        batchBytes: options.batchBytes,
+        concurrency: options.concurrency,
+        maxRetries: options.maxRetries,
+        timeout: options.timeout,
+      }
+      this._conn.bulkUpsert(cppOptions, docs, (cppErr, cppRes) => {
+        const err = errorFromCpp(cppErr)
+        if (err) {
+          return wrapCallback(err, null)
+        }
+        wrapCallback(null, {
+          batches: cppRes.batches.map((batch) => ({
+            firstDocument: batch.firstDocument,
+            documents: batch.documents,
+            bytes: batch.bytes,
+            attempts: batch.attempts,
+            error: errorFromCpp(batch.error),
+          })),
+          succeeded: cppRes.succeeded,
+          failed: cppRes.failed,
+        })
+      })
+    }, callback)
+  }
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Establishes connections to every analytics node in the current cluster config ahead
+   * of time, so that the first queries do not pay the TCP and TLS handshake cost.
+   *
+   * @param options Optional parameters for this operation.
+   * @param callback A node-style callback to be invoked after execution.
+   */
+  async warmup(
+    options?: WarmupOptions,
+    callback?: NodeCallback<WarmupResult>
+  ): Promise<WarmupResult> {
+    if (!options) {
+      options = {}
+    }
+
+    const connectionsPerNode = options.connectionsPerNode ?? 1
+    if (!Number.isInteger(connectionsPerNode) || connectionsPerNode < 1) {
+      throw new InvalidArgumentError(
+        'connectionsPerNode must be a positive integer.'
+      )
+    }
+    if (options.timeout && options.timeout < 0) {
+      throw new Error('timeout must be non-negative.')
+    }
+
+    const timeout = options.timeout
+    return PromiseHelper.wrap((wrapCallback) => {
+      this._conn.warmup(
+        { connectionsPerNode: connectionsPerNode, timeout: timeout },
+        (cppErr, cppRes) => {
+          const err = errorFromCpp(cppErr)
+          if (err) {
+            return wrapCallback(err, null)
+          }
+          wrapCallback(null, cppRes)
+        }
+      )
+    }, callback)
+  }
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Returns the latency scores of the analytics nodes, as observed by the warm-ups run
+   * with {@link Cluster.warmup}.  The scores are purely informational, queries are
+   * dispatched by the core library and are not routed based on them.
+   */
+  nodeScores(): NodeScore[] {
+    return this._conn.nodeScores()
+  }
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Returns how many bytes of result rows are currently buffered by this cluster's
+   * connection.
+   */
+  rowBufferUsage(): RowBufferUsage {
+    return this._conn.rowBufferUsage()
+  }
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Returns the queries recorded by the slow query log (see
+   * {@link ClusterOptions.slowQueryThreshold}) and removes them from the log.
+   */
+  slowQueries(): SlowQueries {
+    return this._conn.slowQueries()
+  }
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Appends the queries recorded by the slow query log to a file, one JSON object per
+   * line, and removes them from the log.  Returns the number of queries written.
+   *
+   * @param filename The file to append the queries to.
+   */
+  flushSlowQueries(filename: string): number {
+    return this._conn.flushSlowQueries(filename)
+  }
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Returns the statistics of the queries executed by this cluster, grouped by the
+   * shape of their statement.  The stats are only collected once
+   * {@link ClusterOptions.maxQueryFingerprints} is set.
+   */
+  queryStats(): QueryStats {
+    return this._conn.queryStats()
+  }
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Discards the statistics returned by {@link queryStats}.
+   */
+  resetQueryStats(): void {
+    this._conn.resetQueryStats()
+  }
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Returns the native memory currently held by this cluster's connection.
+   */
+  nativeMemoryUsage(): NativeMemoryUsage {
+    return this._conn.memoryUsage()
+  }
+
   /**
    * Shuts down this cluster object.  Cleaning up all resources associated with it.
    *
@@ -506,9 +1265,45 @@ export class Cluster {
       securityOpts.trustOnlyCapella = false
     }
 
+    // A DNS SRV connection string names a single host without a port, it can be
+    // bootstrapped straight from the seed nodes it resolved to the last time.
+    if (
+      this._bootstrapCache &&
+      dsnObj.hosts.length === 1 &&
+      !dsnObj.hosts[0][1] &&
+      dsnObj.options.enable_dns_srv !== 'false'
+    ) {
+      const host = dsnObj.hosts[0][0]
+      const cacheKey = `${dsnObj.scheme}://${host}`
+      const seeds = this._bootstrapCache.get(cacheKey)
+      if (seeds) {
+        dsnObj.hosts = seeds
+        dsnObj.options.enable_dns_srv = 'false'
+      }
+      this._bootstrapCache
+        .refresh(
+          cacheKey,
+          host,
+          this._dnsConfig?.nameserver,
+          this._dnsConfig?.port
+        )
+        .catch(() => {
+          // the cache is only an optimization, the next start resolves again
+        })
+    }
+
     const connStr = dsnObj.toString()
     try {
-      this._conn.connect(connStr, authOpts, securityOpts, this._dnsConfig)
+      this._conn.connect(connStr, authOpts, securityOpts, this._dnsConfig, {
+        shareConnection: this._shareConnection,
+        hedgeBudget: this._hedgeBudget,
+        maxBufferedRowBytes: this._maxBufferedRowBytes,
+        slowQueryThreshold: this._slowQueryThreshold,
+        slowQuerySampleRate: this._slowQuerySampleRate,
+        slowQueryLogSize: this._slowQueryLogSize,
+        redactSlowQueries: this._redactSlowQueries,
+        maxQueryFingerprints: this._maxQueryFingerprints,
+      })
     } catch (err) {
       if (err instanceof Error && err.message.includes('Invalid option')) {
         throw new InvalidArgumentError(err.message)
@@ -18,6 +18,7 @@
 import binding from './binding'
 import { Credential } from './credential'
 import { Cluster, ClusterOptions } from './cluster'
+import { NativeRowDecoder } from './deserializers'
 
 /**
  * Acts as the entrypoint into the rest of the library.  Connecting to the cluster
@@ -48,7 +49,8 @@ export const cbppMetadata: string = binding.cbppMetadata
  *
  * Exposes the underlying couchbase++ library protocol logger.  This method is for
  * logging/debugging purposes and must be used with caution as network details will
- * be logged to the provided file.
+ * be logged to the provided file.  Calling this again switches to the new file, and
+ * the protocol logger can be stopped with {@link disableProtocolLogger}.
  *
  * @param filename Name of file protocol logger will save logging details.
  */
@@ -58,6 +60,171 @@ export function enableProtocolLoggerToSaveNetworkTrafficToFile(
   binding.enableProtocolLogger(filename)
 }
 
+/**
+ * Volatile: This API is subject to change at any time.
+ *
+ * Stops the protocol logger enabled by {@link enableProtocolLoggerToSaveNetworkTrafficToFile},
+ * after which network traffic is no longer formatted for logging at all.  It can be
+ * re-enabled at any time.
+ */
+export function disableProtocolLogger(): void {
+  binding.disableProtocolLogger()
+}
+
+/**
+ * Volatile: This API is subject to change at any time.
+ *
+ * Specifies the verbosity of the underlying couchbase++ logger.
+ */
+export enum LogLevel {
+  Trace = 'trace',
+  Debug = 'debug',
+  Info = 'info',
+  Warn = 'warn',
+  Error = 'err',
+  Critical = 'critical',
+  Off = 'off',
+}
+
+/**
+ * Volatile: This API is subject to change at any time.
+ *
+ * Specifies what happens to log messages when the asynchronous logging queue is full.
+ */
+export enum LogDropPolicy {
+  /**
+   * Discards the message being logged.
+   */
+  DropNewest = 'drop_newest',
+
+  /**
+   * Discards the oldest queued message to make room for the message being logged.
+   */
+  DropOldest = 'drop_oldest',
+}
+
+/**
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface AsyncLoggingOptions {
+  /**
+   * The file to write log messages to.  Defaults to stderr.
+   */
+  filename?: string
+
+  /**
+   * The number of messages which can be queued before messages start being dropped.
+   * Rounded up to the next power of two.  Defaults to 8192.
+   */
+  queueSize?: number
+
+  /**
+   * What happens to log messages when the queue is full.  Defaults to
+   * {@link LogDropPolicy.DropNewest}.
+   */
+  dropPolicy?: LogDropPolicy
+
+  /**
+   * The log level to start logging at.  Defaults to {@link LogLevel.Info}.
+   */
+  level?: LogLevel
+}
+
+/**
+ * Volatile: This API is subject to change at any time.
+ *
+ * Counters of an asynchronous logging queue.
+ *
+ * @category Core
+ */
+export interface LogQueueStats {
+  /**
+   * The number of messages which have been queued.
+   */
+  enqueued: number
+
+  /**
+   * The number of messages which have been written out by the background thread.
+   */
+  written: number
+
+  /**
+   * The number of messages which were dropped because the queue was full.
+   */
+  dropped: number
+
+  /**
+   * The capacity of the queue.
+   */
+  queueSize: number
+}
+
+/**
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Core
+ */
+export interface LogStats {
+  /**
+   * The queue of the logger enabled by {@link enableAsyncLogging}, if any.
+   */
+  logger?: LogQueueStats
+
+  /**
+   * The queue of the protocol logger, if it has been enabled.
+   */
+  protocol?: LogQueueStats
+}
+
+/**
+ * Volatile: This API is subject to change at any time.
+ *
+ * Switches the underlying couchbase++ logger to write through a bounded queue
+ * drained by a background thread, so that logging never blocks on console or
+ * file writes.  When the queue is full messages are dropped according to the
+ * drop policy, see {@link logStats} for the number of dropped messages.
+ *
+ * Calling this again redirects the output and drop policy, the queue size is fixed
+ * once the queue has been created.
+ *
+ * @param options Optional parameters for this operation.
+ */
+export function enableAsyncLogging(options?: AsyncLoggingOptions): void {
+  if (!options) {
+    options = {}
+  }
+  binding.enableAsyncLogging({
+    filename: options.filename,
+    queueSize: options.queueSize,
+    dropPolicy: options.dropPolicy,
+    level: options.level,
+  })
+}
+
+/**
+ * Volatile: This API is subject to change at any time.
+ *
+ * Changes the log level of the underlying couchbase++ logger at runtime, taking
+ * precedence over the CBPPLOGLEVEL environment variable.  A console logger is
+ * created if no logger has been enabled yet.
+ *
+ * @param level The log level to switch to.
+ */
+export function setLogLevel(level: LogLevel): void {
+  binding.setLogLevel(level)
+}
+
+/**
+ * Volatile: This API is subject to change at any time.
+ *
+ * Returns the counters of the asynchronous logging queues.
+ */
+export function logStats(): LogStats {
+  return binding.logStats()
+}
+
 /**
  * Volatile: This API is subject to change at any time.
  *
@@ -68,6 +235,20 @@ export function shutdownLogger(): void {
   binding.shutdownLogger()
 }
 
+/**
+ * Volatile: This API is subject to change at any time.
+ *
+ * Registers a native row decoder plugin.  The plugin is a separate native addon
+ * which exports a couchnode_row_decoder structure (see src/couchnode_row_decoder.h)
+ * as an external value.  Registering the same plugin more than once is allowed.
+ *
+ * @param decoder The external value exported by the plugin.
+ * @returns A deserializer which selects the plugin when passed to a query.
+ */
+export function registerRowDecoder(decoder: unknown): NativeRowDecoder {
+  return new NativeRowDecoder(binding.registerRowDecoder(decoder))
+}
+
 export * from './querytypes'
 export * from './database'
 export * from './deserializers'
@@ -56,3 +56,39 @@ export class PassthroughDeserializer implements Deserializer {
     return encoded
   }
 }
+
+/**
+ * Volatile: This API is subject to change at any time.
+ *
+ * Selects a native row decoder plugin registered through {@link registerRowDecoder}.
+ * Rows are decoded by the plugin on the IO thread and are delivered as produced by
+ * the plugin (a Buffer unless the plugin builds its own values), without ever being
+ * converted into a JS string.
+ *
+ * Native row decoders can not be combined with {@link QueryOptions.rowRingBufferSize},
+ * {@link QueryOptions.bufferedMaxBytes} or {@link QueryOptions.keepRows}.
+ *
+ * @category Core
+ */
+export class NativeRowDecoder implements Deserializer {
+  /**
+   * The name the plugin was registered under.
+   */
+  readonly name: string
+
+  /**
+   * @param name The name the plugin was registered under.
+   */
+  constructor(name: string) {
+    this.name = name
+  }
+
+  /**
+   * Returns the row as decoded by the plugin.
+   *
+   * @param decoded The decoded row.
+   */
+  deserialize(decoded: any): any {
+    return decoded
+  }
+}
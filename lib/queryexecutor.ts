@@ -17,15 +17,36 @@
 
 /* eslint jsdoc/require-jsdoc: off */
 import {
+  QueryFieldType,
   QueryMetadata,
   QueryMetrics,
   QueryOptions,
   QueryResult,
+  QueryTimings,
 } from './querytypes'
 import { errorFromCpp, queryScanConsistencyToCpp } from './bindingutilities'
 import { Cluster } from './cluster'
-import { CppColumnarQueryResult, CppColumnarError } from './binding'
-import { OperationCanceledError } from './errors'
+import {
+  CppColumnarQueryResult,
+  CppColumnarError,
+  CppJsonString,
+} from './binding'
+import { NativeRowDecoder } from './deserializers'
+import { InvalidArgumentError, OperationCanceledError } from './errors'
+import { RowRingReader } from './rowring'
+import { RowSpillReader } from './rowspill'
+
+/**
+ * @internal
+ */
+function queryParamToCpp(value: any): CppJsonString {
+  // Strings are encoded up-front as the binding treats string values as
+  // pre-encoded JSON, everything else is serialized natively.
+  if (typeof value === 'string') {
+    return JSON.stringify(value)
+  }
+  return value ?? null
+}
 
 /**
  * @internal
@@ -45,6 +66,10 @@ export class QueryExecutor {
   private _databaseName: string | undefined
   private _scopeName: string | undefined
   private _coreQueryResult: CppColumnarQueryResult | undefined
+  private _rowRing: RowRingReader | undefined
+  private _rowSpill: RowSpillReader | undefined
+  private _collectedRows: string[] | undefined
+  private _collectedComplete: boolean
   private _streamingState: StreamingState
   private _abortController: AbortController
   private _signal: AbortSignal
@@ -62,6 +87,7 @@ export class QueryExecutor {
     this._databaseName = databaseName
     this._scopeName = scopeName
     this._streamingState = StreamingState.NotStarted
+    this._collectedComplete = false
 
     this._abortController = new AbortController()
     this._signal = signal
@@ -80,6 +106,20 @@ export class QueryExecutor {
     return this._coreQueryResult
   }
 
+  /**
+  @internal
+  */
+  get rowRing(): RowRingReader | undefined {
+    return this._rowRing
+  }
+
+  /**
+  @internal
+  */
+  get rowSpill(): RowSpillReader | undefined {
+    return this._rowSpill
+  }
+
   /**
   @internal
   */
@@ -153,25 +193,118 @@ export class QueryExecutor {
         resultSize: metadata.metrics.result_size,
         processedObjects: metadata.metrics.processed_objects,
       }),
+      timings: this.timings(),
     })
   }
 
+  /**
+   * @internal
+   */
+  timings(): QueryTimings {
+    const timings = this._coreQueryResult?.timings()
+    return new QueryTimings(timings || { jsQueued: 0 })
+  }
+
+  /**
+   * @internal
+   */
+  nativeMemoryUsage(): number {
+    return this._coreQueryResult?.memoryUsage() ?? 0
+  }
+
   /**
    * @internal
    */
   getNextRow(
-    callback: (row: string, err: CppColumnarError | null) => void
+    callback: (row: any, err: CppColumnarError | null) => void
   ): void {
+    // rows which were collected natively along with the result come first
+    if (this._collectedRows) {
+      const row = this._collectedRows.shift()
+      if (row !== undefined) {
+        callback(row, null)
+        return
+      }
+      this._collectedRows = undefined
+      if (this._collectedComplete) {
+        callback(undefined, null)
+        return
+      }
+    }
     this._coreQueryResult?.nextRow(callback)
   }
 
   /**
    * @internal
    */
-  query(statement: string, options: QueryOptions): Promise<QueryResult> {
+  query(
+    statement: string | Uint8Array,
+    options: QueryOptions
+  ): Promise<QueryResult> {
     return new Promise((resolve, reject) => {
       const deserializer = options.deserializer || this._cluster.deserializer
 
+      if (options.hedge && !options.readOnly) {
+        throw new InvalidArgumentError('Only read-only queries can be hedged.')
+      }
+      if (options.hedgeDelay && options.hedgeDelay < 0) {
+        throw new InvalidArgumentError('hedgeDelay must be non-negative.')
+      }
+      if (options.keepRows && options.keepRows < 0) {
+        throw new InvalidArgumentError('keepRows must be non-negative.')
+      }
+      if (options.bufferedMaxBytes && options.bufferedMaxBytes < 0) {
+        throw new InvalidArgumentError('bufferedMaxBytes must be non-negative.')
+      }
+      const rowDecoder =
+        deserializer instanceof NativeRowDecoder ? deserializer.name : undefined
+      if (
+        rowDecoder &&
+        (options.rowRingBufferSize ||
+          options.bufferedMaxBytes ||
+          options.keepRows)
+      ) {
+        throw new InvalidArgumentError(
+          'Native row decoders can not be used with rowRingBufferSize, bufferedMaxBytes or keepRows.'
+        )
+      }
+      if (
+        options.spillToDisk &&
+        (rowDecoder ||
+          options.rowRingBufferSize ||
+          options.bufferedMaxBytes ||
+          options.metadataOnly)
+      ) {
+        throw new InvalidArgumentError(
+          'spillToDisk can not be used with native row decoders, rowRingBufferSize, bufferedMaxBytes or metadataOnly.'
+        )
+      }
+      if (rowDecoder && options.schema) {
+        throw new InvalidArgumentError(
+          'Native row decoders can not be used with a schema.'
+        )
+      }
+      if (options.schema) {
+        const fieldTypes = Object.values(QueryFieldType) as string[]
+        const fieldNames = new Set<string>()
+        for (const field of options.schema) {
+          if (typeof field !== 'object' || field === null) {
+            throw new InvalidArgumentError('Schema fields must be objects.')
+          }
+          if (!fieldTypes.includes(field.type)) {
+            throw new InvalidArgumentError(
+              `Unknown schema field type '${field.type}'.`
+            )
+          }
+          if (fieldNames.has(field.name)) {
+            throw new InvalidArgumentError(
+              `Duplicate schema field '${field.name}'.`
+            )
+          }
+          fieldNames.add(field.name)
+        }
+      }
+
       const { cppQueryErr, cppQueryResult } = this._cluster.conn.query(
         {
           statement: statement,
@@ -179,7 +312,7 @@ export class QueryExecutor {
           scope_name: this._scopeName,
           priority: options.priority,
           positional_parameters: options.positionalParameters
-            ? options.positionalParameters.map((v) => JSON.stringify(v ?? null))
+            ? options.positionalParameters.map((v) => queryParamToCpp(v))
             : [],
           named_parameters: options.namedParameters
             ? Object.fromEntries(
@@ -187,7 +320,7 @@ export class QueryExecutor {
                   options.namedParameters as { [key: string]: any }
                 )
                   .filter(([, v]) => v !== undefined)
-                  .map(([k, v]) => [k, JSON.stringify(v)])
+                  .map(([k, v]) => [k, queryParamToCpp(v)])
               )
             : {},
           read_only: options.readOnly,
@@ -196,24 +329,53 @@ export class QueryExecutor {
             ? Object.fromEntries(
                 Object.entries(options.raw)
                   .filter(([, v]) => v !== undefined)
-                  .map(([k, v]) => [k, JSON.stringify(v)])
+                  .map(([k, v]) => [k, queryParamToCpp(v)])
               )
             : {},
           timeout: options.timeout,
         },
-        (cppErr) => {
+        (cppErr, collected) => {
           const err = errorFromCpp(cppErr)
           if (err && !(err instanceof OperationCanceledError)) {
             reject(err)
             return
           }
           try {
+            if (collected) {
+              this._collectedRows = collected.rows
+              this._collectedComplete = collected.complete
+            } else if (!err && options.spillToDisk && this._coreQueryResult) {
+              this._rowSpill = new RowSpillReader(
+                this._coreQueryResult,
+                options.spillDirectory
+              )
+            } else if (
+              !err &&
+              options.rowRingBufferSize &&
+              this._coreQueryResult
+            ) {
+              this._rowRing = new RowRingReader(
+                this._coreQueryResult,
+                options.rowRingBufferSize
+              )
+            }
             // this will raise an error w/ the coreQueryResult is null
             const qRes = new QueryResult(this, deserializer)
             resolve(qRes)
           } catch (err) {
             reject(err)
           }
+        },
+        {
+          hedge: options.hedge,
+          hedgeDelay: options.hedgeDelay,
+          collectRows: options.metadataOnly
+            ? { keepRows: options.keepRows ?? 0, drain: true }
+            : options.bufferedMaxBytes
+              ? { maxBytes: options.bufferedMaxBytes, drain: false }
+              : undefined,
+          rowDecoder: rowDecoder,
+          schema: options.schema,
         }
       )
 
@@ -19,6 +19,8 @@ import { Deserializer } from './deserializers'
 import { QueryExecutor } from './queryexecutor'
 import { Readable } from 'stream'
 import { errorFromCpp } from './bindingutilities'
+import { RowRingReader, RowRingStatus } from './rowring'
+import { RowSpillReader, RowSpillStatus } from './rowspill'
 
 /**
  * Contains the results of a columnar query.
@@ -64,6 +66,26 @@ export class QueryResult {
   metadata(): QueryMetadata {
     return this._executor.metadata()
   }
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Returns the client side phases of the query reached so far.  Unlike the metadata,
+   * it can be called at any time while the rows are being iterated.
+   */
+  timings(): QueryTimings {
+    return this._executor.timings()
+  }
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Returns the number of bytes held natively for this result, such as rows which have
+   * been received but not yet consumed.
+   */
+  nativeMemoryUsage(): number {
+    return this._executor.nativeMemoryUsage()
+  }
 }
 
 /**
@@ -128,6 +150,17 @@ export class QueryResultStream extends Readable {
    */
   // eslint-disable-next-line @typescript-eslint/no-unused-vars
   override _read(size: number): void {
+    const rowRing = this._executor.rowRing
+    if (rowRing) {
+      this._readRowRing(rowRing)
+      return
+    }
+    const rowSpill = this._executor.rowSpill
+    if (rowSpill) {
+      this._readRowSpill(rowSpill)
+      return
+    }
+
     this._executor.getNextRow((row, cppErr) => {
       const err = errorFromCpp(cppErr)
       if (err) {
@@ -140,10 +173,71 @@ export class QueryResultStream extends Readable {
         return
       }
 
-      this.push(this._deserializer.deserialize(row))
+      // rows decoded natively (against a schema or by a plugin) are not strings
+      this.push(
+        typeof row === 'string' ? this._deserializer.deserialize(row) : row
+      )
     })
   }
 
+  /**
+   * @internal
+   */
+  private _readRowRing(rowRing: RowRingReader): void {
+    for (;;) {
+      const status = rowRing.read((row) =>
+        this.push(this._deserializer.deserialize(row))
+      )
+      if (status === RowRingStatus.Paused) {
+        return
+      }
+      if (status === RowRingStatus.End) {
+        this.push(null)
+        this._executor.streamingComplete()
+        return
+      }
+      if (status === RowRingStatus.Error) {
+        this.destroy(errorFromCpp(rowRing.error()) ?? undefined)
+        return
+      }
+      if (!rowRing.wait(() => this._readRowRing(rowRing))) {
+        return
+      }
+    }
+  }
+
+  /**
+   * @internal
+   */
+  private _readRowSpill(rowSpill: RowSpillReader): void {
+    for (;;) {
+      let status: RowSpillStatus
+      try {
+        status = rowSpill.read((row) =>
+          this.push(this._deserializer.deserialize(row))
+        )
+      } catch (err) {
+        this.destroy(err as Error)
+        return
+      }
+      if (status === RowSpillStatus.Paused) {
+        return
+      }
+      if (status === RowSpillStatus.End) {
+        this.push(null)
+        this._executor.streamingComplete()
+        return
+      }
+      if (status === RowSpillStatus.Error) {
+        this.destroy(errorFromCpp(rowSpill.error()) ?? undefined)
+        return
+      }
+      if (!rowSpill.wait(() => this._readRowSpill(rowSpill))) {
+        return
+      }
+    }
+  }
+
   /**
    * @internal
    */
@@ -180,6 +274,13 @@ export class QueryMetadata {
    */
   metrics: QueryMetrics
 
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * The client side phases of the query, see {@link QueryTimings}.
+   */
+  timings: QueryTimings
+
   /**
    * @internal
    */
@@ -187,6 +288,63 @@ export class QueryMetadata {
     this.requestId = data.requestId
     this.warnings = data.warnings
     this.metrics = data.metrics
+    this.timings = data.timings
+  }
+}
+
+/**
+ * Contains the client side phases of a query, as offsets in milliseconds from the
+ * moment the query was issued.  Phases which have not been reached are undefined.
+ *
+ * Comparing the phases attributes the time of a slow query: from dispatched to
+ * firstByte is spent on the network and server, from firstRow to lastRow mostly on
+ * streaming the rows, and jsQueued is spent waiting for a busy event loop.
+ *
+ * Volatile: This API is subject to change at any time.
+ *
+ * @category Query
+ */
+export class QueryTimings {
+  /**
+   * When the query was handed over to be sent to the cluster.
+   */
+  dispatched?: number
+
+  /**
+   * When the response started arriving.
+   */
+  firstByte?: number
+
+  /**
+   * When the first row was read.
+   */
+  firstRow?: number
+
+  /**
+   * When the most recent row was read.
+   */
+  lastRow?: number
+
+  /**
+   * When the end of the result (or the error) was read.
+   */
+  finished?: number
+
+  /**
+   * The total time the query's completions spent queued waiting for the JS thread.
+   */
+  jsQueued: number
+
+  /**
+   * @internal
+   */
+  constructor(data: QueryTimings) {
+    this.dispatched = data.dispatched
+    this.firstByte = data.firstByte
+    this.firstRow = data.firstRow
+    this.lastRow = data.lastRow
+    this.finished = data.finished
+    this.jsQueued = data.jsQueued
   }
 }
 
@@ -283,17 +441,73 @@ export enum QueryScanConsistency {
   RequestPlus = 'request_plus',
 }
 
+/**
+ * Volatile: This API is subject to change at any time.
+ *
+ * The types of the fields of a {@link QueryField}.
+ *
+ * @category Query
+ */
+export enum QueryFieldType {
+  /**
+   * The field holds a string.
+   */
+  String = 'string',
+
+  /**
+   * The field holds a number.
+   */
+  Number = 'number',
+
+  /**
+   * The field holds a boolean.
+   */
+  Boolean = 'boolean',
+
+  /**
+   * The field holds any JSON value, such as a nested object or array.
+   */
+  Any = 'any',
+}
+
+/**
+ * Volatile: This API is subject to change at any time.
+ *
+ * Describes a top level field of the rows of a query, see {@link QueryOptions.schema}.
+ *
+ * @category Query
+ */
+export interface QueryField {
+  /**
+   * The name of the field.
+   */
+  name: string
+
+  /**
+   * The type of the field's value.
+   */
+  type: QueryFieldType
+
+  /**
+   * Indicates whether the field may be null, which is always allowed for fields of
+   * type {@link QueryFieldType.Any}.  Defaults to false.
+   */
+  nullable?: boolean
+}
+
 /**
  * @category Query
  */
 export interface QueryOptions {
   /**
    * Positional values to be used for the placeholders within the query.
+   * Buffer or Uint8Array values are sent as-is and must contain UTF-8 encoded JSON.
    */
   positionalParameters?: any[]
 
   /**
    * Named values to be used for the placeholders within the query.
+   * Buffer or Uint8Array values are sent as-is and must contain UTF-8 encoded JSON.
    */
   namedParameters?: { [key: string]: any }
 
@@ -316,7 +530,8 @@ export interface QueryOptions {
 
   /**
    * Specifies any additional parameters which should be passed to the query engine
-   * when executing the query.
+   * when executing the query.  Buffer or Uint8Array values are sent as-is and must
+   * contain UTF-8 encoded JSON.
    */
   raw?: { [key: string]: any }
 
@@ -335,4 +550,95 @@ export interface QueryOptions {
    * Sets an abort signal for the query allowing the operation to be cancelled.
    */
   abortSignal?: AbortSignal
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Indicates whether a duplicate of this query should be sent when no response has
+   * arrived within the hedge delay, the first response to arrive is used and the other
+   * request is cancelled.  Only supported for read-only queries, and limited by the
+   * cluster's {@link ClusterOptions.hedgeBudget}.
+   */
+  hedge?: boolean
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * The delay before a hedged request is sent, represented in milliseconds.  Defaults to
+   * the 95th percentile of the recently observed query response times.
+   */
+  hedgeDelay?: number
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Streams the rows through a shared memory ring buffer of (at least) the given size in
+   * bytes, rather than delivering each row through the event loop.  The event loop is
+   * only woken up when the ring runs empty, which greatly reduces the per-row overhead of
+   * high volume results.  Rows larger than the ring are still supported.
+   */
+  rowRingBufferSize?: number
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Indicates that the rows of this query are not needed, such as for DML and DDL
+   * statements.  The rows are read and discarded by the client without being handed
+   * to JavaScript, and the query only completes once all of them have been read, at
+   * which point {@link QueryResult.metadata} is available right away.  The number of
+   * rows is available through the result count of the metadata's metrics.
+   */
+  metadataOnly?: boolean
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * The number of leading rows which are still returned by {@link QueryResult.rows} when
+   * {@link QueryOptions.metadataOnly} is set.  Defaults to 0.
+   */
+  keepRows?: number
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Collects the rows of the query before completing it, up to the given number of
+   * bytes, so that small results are delivered together with the query's completion
+   * rather than row by row.  Once the limit is exceeded the remaining rows are streamed
+   * as usual.  When the whole result fit, {@link QueryResult.metadata} is available
+   * right away.
+   */
+  bufferedMaxBytes?: number
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * The fields of the rows of this query.  Rows which are objects with exactly these
+   * fields, of the given types, are decoded natively into objects which all share the
+   * same shape, with the properties in the order of the schema.  Any other rows are
+   * passed to the deserializer as usual.  Only applies to rows streamed one at a time,
+   * rather than through {@link QueryOptions.rowRingBufferSize},
+   * {@link QueryOptions.bufferedMaxBytes} or {@link QueryOptions.spillToDisk}.
+   */
+  schema?: QueryField[]
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * Drains the rows into a temporary file as fast as they arrive, rather than throttling
+   * the server's connection while they are consumed.  The connection is released as soon
+   * as all rows have been received, and {@link QueryResult.rows} reads them back from the
+   * file at the consumer's pace.  Meant for large results which are consumed slowly,
+   * such as exports.  The file is only readable by the current user and is removed from
+   * the directory right after it has been created, its space is reclaimed once all rows
+   * have been read or the result is garbage collected.
+   */
+  spillToDisk?: boolean
+
+  /**
+   * Volatile: This API is subject to change at any time.
+   *
+   * The directory in which {@link QueryOptions.spillToDisk} creates its temporary file.
+   * Defaults to the operating system's temporary directory.
+   */
+  spillDirectory?: string
 }
@@ -0,0 +1,145 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+import { CppColumnarError, CppColumnarQueryResult } from './binding'
+
+// Layout of the shared memory, see src/row_ring.hpp.
+const HEADER_SIZE = 16
+const HEAD = 0
+const TAIL = 1
+const STATE = 2
+const BLOCKED = 3
+const STATE_END = 1
+const RECORD_WRAP = -1
+const RECORD_OVERSIZED = -2
+const MIN_CAPACITY = 4096
+const MAX_CAPACITY = 1 << 30
+
+/**
+ * @internal
+ */
+export enum RowRingStatus {
+  Paused = 0,
+  Empty,
+  End,
+  Error,
+}
+
+/**
+ * Reads the rows which the binding writes into a SharedArrayBuffer ring.
+ *
+ * @internal
+ */
+export class RowRingReader {
+  private _core: CppColumnarQueryResult
+  private _header: Int32Array
+  private _records: Int32Array
+  private _bytes: Buffer
+  private _capacity: number
+  private _onReadable: (() => void) | undefined
+
+  constructor(core: CppColumnarQueryResult, size: number) {
+    let capacity = MIN_CAPACITY
+    while (capacity < size && capacity < MAX_CAPACITY) {
+      capacity *= 2
+    }
+
+    const memory = new SharedArrayBuffer(HEADER_SIZE + capacity)
+    this._core = core
+    this._header = new Int32Array(memory, 0, 4)
+    this._records = new Int32Array(memory, HEADER_SIZE)
+    this._bytes = Buffer.from(memory, HEADER_SIZE)
+    this._capacity = capacity
+
+    core.startRowRing(new Uint8Array(memory), () => {
+      const onReadable = this._onReadable
+      this._onReadable = undefined
+      if (onReadable) {
+        onReadable()
+      }
+    })
+  }
+
+  /**
+   * Hands the available rows to onRow until it returns false or the ring is empty.
+   */
+  read(onRow: (row: string) => boolean): RowRingStatus {
+    let head = Atomics.load(this._header, HEAD) >>> 0
+    let status: RowRingStatus
+    for (;;) {
+      const tail = Atomics.load(this._header, TAIL) >>> 0
+      if (head === tail) {
+        const state = Atomics.load(this._header, STATE)
+        if (state === 0) {
+          status = RowRingStatus.Empty
+          break
+        }
+        // the final rows are always written before the state is set
+        if (Atomics.load(this._header, TAIL) >>> 0 !== head) {
+          continue
+        }
+        status = state === STATE_END ? RowRingStatus.End : RowRingStatus.Error
+        break
+      }
+
+      const index = head & (this._capacity - 1)
+      const length = this._records[index >> 2]
+      if (length === RECORD_WRAP) {
+        head = (head + this._capacity - index) >>> 0
+        Atomics.store(this._header, HEAD, head | 0)
+        continue
+      }
+
+      let row: string
+      if (length === RECORD_OVERSIZED) {
+        row = this._core.rowRingTakeRow()
+        head = (head + 4) >>> 0
+      } else {
+        row = this._bytes.toString('utf8', index + 4, index + 4 + length)
+        head = (head + 4 + ((length + 3) & ~3)) >>> 0
+      }
+      Atomics.store(this._header, HEAD, head | 0)
+
+      if (!onRow(row)) {
+        status = RowRingStatus.Paused
+        break
+      }
+    }
+
+    if (Atomics.load(this._header, BLOCKED) !== 0) {
+      this._core.rowRingResume()
+    }
+    return status
+  }
+
+  /**
+   * Asks to be notified once the ring is no longer empty.  Returns true, without
+   * registering the callback, if there is something to read already.
+   */
+  wait(onReadable: () => void): boolean {
+    this._onReadable = onReadable
+    if (this._core.rowRingWait()) {
+      this._onReadable = undefined
+      return true
+    }
+    return false
+  }
+
+  error(): CppColumnarError | null {
+    return this._core.rowRingError()
+  }
+}
@@ -0,0 +1,102 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+import { randomUUID } from 'crypto'
+import * as os from 'os'
+import * as path from 'path'
+import { CppColumnarError, CppColumnarQueryResult } from './binding'
+
+const READ_BATCH_ROWS = 256
+
+/**
+ * @internal
+ */
+export enum RowSpillStatus {
+  Paused = 0,
+  Empty,
+  End,
+  Error,
+}
+
+/**
+ * Reads back the rows which the binding spills into a temporary file.
+ *
+ * @internal
+ */
+export class RowSpillReader {
+  private _core: CppColumnarQueryResult
+  private _onReadable: (() => void) | undefined
+
+  constructor(core: CppColumnarQueryResult, directory?: string) {
+    this._core = core
+    const filename = path.join(
+      directory ?? os.tmpdir(),
+      `columnar-spill-${process.pid}-${randomUUID()}`
+    )
+
+    core.startSpill(filename, () => {
+      const onReadable = this._onReadable
+      this._onReadable = undefined
+      if (onReadable) {
+        onReadable()
+      }
+    })
+  }
+
+  /**
+   * Hands the available rows to onRow until it returns false or no more rows have
+   * been spilled yet.
+   */
+  read(onRow: (row: string) => boolean): RowSpillStatus {
+    for (;;) {
+      const rows = this._core.spillRead(READ_BATCH_ROWS)
+      if (rows.length === 0) {
+        if (!this._core.spillDone()) {
+          return RowSpillStatus.Empty
+        }
+        return this._core.spillError()
+          ? RowSpillStatus.Error
+          : RowSpillStatus.End
+      }
+      // every row which was read has to be handed over, there is no way back
+      let paused = false
+      for (const row of rows) {
+        paused = !onRow(row) || paused
+      }
+      if (paused) {
+        return RowSpillStatus.Paused
+      }
+    }
+  }
+
+  /**
+   * Asks to be notified once more rows have been spilled.  Returns true, without
+   * registering the callback, if there is something to read already.
+   */
+  wait(onReadable: () => void): boolean {
+    this._onReadable = onReadable
+    if (this._core.spillWait()) {
+      this._onReadable = undefined
+      return true
+    }
+    return false
+  }
+
+  error(): CppColumnarError | null {
+    return this._core.spillError()
+  }
+}
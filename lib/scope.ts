@@ -67,11 +67,12 @@ export class Scope {
   /**
    * Executes a query against the Columnar scope.
    *
-   * @param statement The columnar SQL++ statement to execute.
+   * @param statement The columnar SQL++ statement to execute, either as a string or as
+   *  UTF-8 encoded bytes.
    * @param options Optional parameters for this operation.
    */
   executeQuery(
-    statement: string,
+    statement: string | Uint8Array,
     options?: QueryOptions
   ): Promise<QueryResult> {
     if (!options) {
@@ -18,42 +18,305 @@
 #include "addondata.hpp"
 #include "connection.hpp"
 #include "constants.hpp"
+#include "jstocbpp.hpp"
+#include "logging.hpp"
 #include "query_result.hpp"
+#include "row_decoder.hpp"
 #include <core/logger/configuration.hxx>
 #include <core/meta/version.hxx>
+#include <mutex>
 #include <napi.h>
+#include <optional>
+#include <spdlog/sinks/basic_file_sink.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
 namespace couchnode
 {
 
+// Logging is process-wide, so this state is shared by every environment (main
+// thread and worker threads) the addon has been loaded into.
+static std::mutex loggingMutex;
+static bool loggerCreated = false;
+static couchbase::core::logger::level loggerLevel = couchbase::core::logger::level::off;
+static std::shared_ptr<AsyncLogSink> asyncLogSink;
+static std::shared_ptr<AsyncLogSink> protocolLogSink;
+
+static constexpr std::size_t default_log_queue_size = 8192;
+
+// Creates the core logger, writing through the async sink once async logging
+// has been enabled and to the console otherwise.  The core hands messages to
+// its own logging thread, which only ever enqueues them into the sink, so it
+// never waits on the actual writes either.
+static std::optional<std::string>
+createLoggerLocked()
+{
+  if (!asyncLogSink) {
+    couchbase::core::logger::create_console_logger();
+    loggerCreated = true;
+    return {};
+  }
+  couchbase::core::logger::configuration configuration{};
+  configuration.sink = asyncLogSink;
+  configuration.log_level = loggerLevel;
+  if (auto err = couchbase::core::logger::create_file_logger(configuration); err) {
+    return err;
+  }
+  loggerCreated = true;
+  return {};
+}
+
+static bool
+parseLogLevel(const std::string& logLevelStr,
+              spdlog::level::level_enum& spdLogLevel,
+              couchbase::core::logger::level& cbppLogLevel)
+{
+  if (logLevelStr == "trace") {
+    spdLogLevel = spdlog::level::trace;
+    cbppLogLevel = couchbase::core::logger::level::trace;
+  } else if (logLevelStr == "debug") {
+    spdLogLevel = spdlog::level::debug;
+    cbppLogLevel = couchbase::core::logger::level::debug;
+  } else if (logLevelStr == "info") {
+    spdLogLevel = spdlog::level::info;
+    cbppLogLevel = couchbase::core::logger::level::info;
+  } else if (logLevelStr == "warn") {
+    spdLogLevel = spdlog::level::warn;
+    cbppLogLevel = couchbase::core::logger::level::warn;
+  } else if (logLevelStr == "err") {
+    spdLogLevel = spdlog::level::err;
+    cbppLogLevel = couchbase::core::logger::level::err;
+  } else if (logLevelStr == "critical") {
+    spdLogLevel = spdlog::level::critical;
+    cbppLogLevel = couchbase::core::logger::level::critical;
+  } else if (logLevelStr == "off") {
+    spdLogLevel = spdlog::level::off;
+    cbppLogLevel = couchbase::core::logger::level::off;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static AsyncLogSink::drop_policy
+parseDropPolicy(Napi::Env env, Napi::Value jsPolicy)
+{
+  if (jsPolicy.IsUndefined() || jsPolicy.IsNull()) {
+    return AsyncLogSink::drop_policy::drop_newest;
+  }
+  auto policy = jsPolicy.ToString().Utf8Value();
+  if (policy == "drop_newest") {
+    return AsyncLogSink::drop_policy::drop_newest;
+  }
+  if (policy == "drop_oldest") {
+    return AsyncLogSink::drop_policy::drop_oldest;
+  }
+  throw Napi::Error::New(env, "Invalid log drop policy: " + policy);
+}
+
+static Napi::Value
+logSinkStatsToJs(Napi::Env env, const std::shared_ptr<AsyncLogSink>& sink)
+{
+  if (!sink) {
+    return env.Undefined();
+  }
+  auto stats = sink->snapshot();
+  auto resObj = Napi::Object::New(env);
+  resObj.Set("enqueued", Napi::Number::New(env, static_cast<double>(stats.enqueued)));
+  resObj.Set("written", Napi::Number::New(env, static_cast<double>(stats.written)));
+  resObj.Set("dropped", Napi::Number::New(env, static_cast<double>(stats.dropped)));
+  resObj.Set("queueSize", Napi::Number::New(env, static_cast<double>(stats.capacity)));
+  return resObj;
+}
+
 Napi::Value
 enable_protocol_logger(const Napi::CallbackInfo& info)
 {
   try {
     auto filename = info[0].ToString().Utf8Value();
+    auto fileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(filename);
+
+    std::lock_guard<std::mutex> lock(loggingMutex);
+    if (protocolLogSink) {
+      // the protocol logger already exists, point it at the new file
+      protocolLogSink->setTarget(std::move(fileSink));
+      return info.Env().Null();
+    }
+
+    protocolLogSink = std::make_shared<AsyncLogSink>(
+      std::move(fileSink), default_log_queue_size, AsyncLogSink::drop_policy::drop_newest);
     couchbase::core::logger::configuration configuration{};
     configuration.filename = filename;
-    couchbase::core::logger::create_protocol_logger(configuration);
+    configuration.sink = protocolLogSink;
+    if (auto err = couchbase::core::logger::create_protocol_logger(configuration); err) {
+      protocolLogSink.reset();
+      return Napi::Error::New(info.Env(), *err).Value();
+    }
+  } catch (const std::exception& e) {
+    return Napi::Error::New(info.Env(), e.what()).Value();
+  } catch (...) {
+    return Napi::Error::New(info.Env(), "Unexpected C++ error").Value();
+  }
+  return info.Env().Null();
+}
+
+Napi::Value
+disable_protocol_logger(const Napi::CallbackInfo& info)
+{
+  try {
+    std::lock_guard<std::mutex> lock(loggingMutex);
+    if (!protocolLogSink) {
+      return info.Env().Null();
+    }
+
+    // The core formats every packet for as long as a protocol logger exists, and
+    // only releases it by shutting all of its loggers down, so the main logger is
+    // recreated around the same sink afterwards.
+    couchbase::core::logger::shutdown();
+    protocolLogSink.reset();
+    if (loggerCreated) {
+      if (auto err = createLoggerLocked(); err) {
+        loggerCreated = false;
+        return Napi::Error::New(info.Env(), *err).Value();
+      }
+      couchbase::core::logger::set_log_levels(loggerLevel);
+    }
+  } catch (const std::exception& e) {
+    return Napi::Error::New(info.Env(), e.what()).Value();
   } catch (...) {
     return Napi::Error::New(info.Env(), "Unexpected C++ error").Value();
   }
   return info.Env().Null();
 }
 
+Napi::Value
+enable_async_logging(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  auto optionsObj = info[0].As<Napi::Object>();
+  auto jsFilename = optionsObj.Get("filename");
+  auto jsQueueSize = optionsObj.Get("queueSize");
+  auto jsLevel = optionsObj.Get("level");
+
+  auto queueSize = default_log_queue_size;
+  if (!jsQueueSize.IsUndefined() && !jsQueueSize.IsNull()) {
+    queueSize = jsToCbpp<std::size_t>(jsQueueSize);
+  }
+  auto policy = parseDropPolicy(env, optionsObj.Get("dropPolicy"));
+
+  auto spdLogLevel = spdlog::level::info;
+  auto cbppLogLevel = couchbase::core::logger::level::info;
+  if (!jsLevel.IsUndefined() && !jsLevel.IsNull()) {
+    auto level = jsLevel.ToString().Utf8Value();
+    if (!parseLogLevel(level, spdLogLevel, cbppLogLevel)) {
+      throw Napi::Error::New(env, "Invalid log level: " + level);
+    }
+  }
+
+  try {
+    std::shared_ptr<spdlog::sinks::sink> target;
+    if (!jsFilename.IsUndefined() && !jsFilename.IsNull()) {
+      target =
+        std::make_shared<spdlog::sinks::basic_file_sink_mt>(jsFilename.ToString().Utf8Value());
+    } else {
+      target = std::make_shared<spdlog::sinks::stderr_color_sink_mt>();
+    }
+
+    std::lock_guard<std::mutex> lock(loggingMutex);
+    loggerLevel = cbppLogLevel;
+    if (asyncLogSink) {
+      asyncLogSink->setTarget(std::move(target));
+      asyncLogSink->setDropPolicy(policy);
+    } else {
+      asyncLogSink = std::make_shared<AsyncLogSink>(std::move(target), queueSize, policy);
+      if (auto err = createLoggerLocked(); err) {
+        asyncLogSink.reset();
+        return Napi::Error::New(env, *err).Value();
+      }
+    }
+    spdlog::set_level(spdLogLevel);
+    couchbase::core::logger::set_log_levels(cbppLogLevel);
+  } catch (const std::exception& e) {
+    return Napi::Error::New(env, e.what()).Value();
+  } catch (...) {
+    return Napi::Error::New(env, "Unexpected C++ error").Value();
+  }
+  return env.Null();
+}
+
+Napi::Value
+set_log_level(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  auto level = info[0].ToString().Utf8Value();
+  auto spdLogLevel = spdlog::level::off;
+  auto cbppLogLevel = couchbase::core::logger::level::off;
+  if (!parseLogLevel(level, spdLogLevel, cbppLogLevel)) {
+    throw Napi::Error::New(env, "Invalid log level: " + level);
+  }
+
+  try {
+    std::lock_guard<std::mutex> lock(loggingMutex);
+    loggerLevel = cbppLogLevel;
+    if (!loggerCreated && cbppLogLevel != couchbase::core::logger::level::off) {
+      createLoggerLocked();
+    }
+    spdlog::set_level(spdLogLevel);
+    couchbase::core::logger::set_log_levels(cbppLogLevel);
+  } catch (...) {
+    return Napi::Error::New(env, "Unexpected C++ error").Value();
+  }
+  return env.Null();
+}
+
+Napi::Value
+log_stats(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  std::lock_guard<std::mutex> lock(loggingMutex);
+  auto resObj = Napi::Object::New(env);
+  resObj.Set("logger", logSinkStatsToJs(env, asyncLogSink));
+  resObj.Set("protocol", logSinkStatsToJs(env, protocolLogSink));
+  return resObj;
+}
+
 Napi::Value
 shutdown_logger(const Napi::CallbackInfo& info)
 {
   try {
     couchbase::core::logger::shutdown();
+
+    // dropping our references joins the sink workers once the loggers which
+    // were using them are gone
+    std::lock_guard<std::mutex> lock(loggingMutex);
+    asyncLogSink.reset();
+    protocolLogSink.reset();
+    loggerCreated = false;
   } catch (...) {
     return Napi::Error::New(info.Env(), "Unexpected C++ error").Value();
   }
   return info.Env().Null();
 }
 
-Napi::Object
-Init(Napi::Env env, Napi::Object exports)
+Napi::Value
+register_row_decoder(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  if (info.Length() < 1 || !info[0].IsExternal()) {
+    throw Napi::TypeError::New(env, "Row decoder must be an external value exported by a plugin");
+  }
+  // Externals of other addons can hold anything, the magic number is checked by
+  // registerRowDecoder but there has to be something to read it from.
+  auto decoder = info[0].As<Napi::External<couchnode_row_decoder>>().Data();
+  if (decoder == nullptr) {
+    throw Napi::TypeError::New(env, "Row decoder must be an external value exported by a plugin");
+  }
+  registerRowDecoder(env, decoder);
+  return Napi::String::New(env, decoder->name);
+}
+
+static void
+initLogging()
 {
   spdlog::set_pattern("[%Y-%m-%d %T.%e] [%P,%t] [%^%l%$] %oms, %v");
 
@@ -62,33 +325,25 @@ Init(Napi::Env env, Napi::Object exports)
   {
     const char* logLevelCstr = getenv("CBPPLOGLEVEL");
     if (logLevelCstr) {
-      std::string logLevelStr = logLevelCstr;
-      if (logLevelStr == "trace") {
-        spdLogLevel = spdlog::level::trace;
-        cbppLogLevel = couchbase::core::logger::level::trace;
-      } else if (logLevelStr == "debug") {
-        spdLogLevel = spdlog::level::debug;
-        cbppLogLevel = couchbase::core::logger::level::debug;
-      } else if (logLevelStr == "info") {
-        spdLogLevel = spdlog::level::info;
-        cbppLogLevel = couchbase::core::logger::level::info;
-      } else if (logLevelStr == "warn") {
-        spdLogLevel = spdlog::level::warn;
-        cbppLogLevel = couchbase::core::logger::level::warn;
-      } else if (logLevelStr == "err") {
-        spdLogLevel = spdlog::level::err;
-        cbppLogLevel = couchbase::core::logger::level::err;
-      } else if (logLevelStr == "critical") {
-        spdLogLevel = spdlog::level::critical;
-        cbppLogLevel = couchbase::core::logger::level::critical;
-      }
+      parseLogLevel(logLevelCstr, spdLogLevel, cbppLogLevel);
     }
   }
+  std::lock_guard<std::mutex> lock(loggingMutex);
+  loggerLevel = cbppLogLevel;
   if (cbppLogLevel != couchbase::core::logger::level::off) {
-    couchbase::core::logger::create_console_logger();
+    createLoggerLocked();
   }
   spdlog::set_level(spdLogLevel);
   couchbase::core::logger::set_log_levels(cbppLogLevel);
+}
+
+Napi::Object
+Init(Napi::Env env, Napi::Object exports)
+{
+  // The addon is initialized once per environment (main thread and each
+  // worker thread), but the loggers are process-wide.
+  static std::once_flag loggingInitialized;
+  std::call_once(loggingInitialized, initLogging);
 
   AddonData::Init(env, exports);
   Constants::Init(env, exports);
@@ -100,7 +355,15 @@ Init(Napi::Env env, Napi::Object exports)
               Napi::String::New(env, couchbase::core::meta::sdk_build_info_json()));
   exports.Set(Napi::String::New(env, "enableProtocolLogger"),
               Napi::Function::New<enable_protocol_logger>(env));
+  exports.Set(Napi::String::New(env, "disableProtocolLogger"),
+              Napi::Function::New<disable_protocol_logger>(env));
+  exports.Set(Napi::String::New(env, "enableAsyncLogging"),
+              Napi::Function::New<enable_async_logging>(env));
+  exports.Set(Napi::String::New(env, "setLogLevel"), Napi::Function::New<set_log_level>(env));
+  exports.Set(Napi::String::New(env, "logStats"), Napi::Function::New<log_stats>(env));
   exports.Set(Napi::String::New(env, "shutdownLogger"), Napi::Function::New<shutdown_logger>(env));
+  exports.Set(Napi::String::New(env, "registerRowDecoder"),
+              Napi::Function::New<register_row_decoder>(env));
   return exports;
 }
 
@@ -0,0 +1,238 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "bulk_upsert.hpp"
+#include "instance.hpp"
+#include <algorithm>
+#include <asio/steady_timer.hpp>
+#include <core/columnar/error_codes.hxx>
+#include <core/columnar/query_options.hxx>
+#include <core/json_string.hxx>
+#include <exception>
+#include <tao/json.hpp>
+#include <utility>
+#include <variant>
+
+namespace couchnode
+{
+
+static constexpr std::chrono::milliseconds retry_backoff_min{ 100 };
+static constexpr std::chrono::milliseconds retry_backoff_max{ 5000 };
+
+// Only errors which reject a statement before it runs are retried: the service
+// being temporarily unavailable (23000), overloaded (23003) or its job queue
+// being full (23007).  Anything else is either permanent or, like a timeout,
+// ambiguous, and core has already retried what it could within the timeout.
+static bool
+isRetriable(const couchbase::core::columnar::error& err)
+{
+  if (err.ec != couchbase::core::columnar::errc::query_error) {
+    return false;
+  }
+  auto properties =
+    std::get_if<couchbase::core::columnar::query_error_properties>(&err.properties);
+  return properties != nullptr &&
+         (properties->code == 23000 || properties->code == 23003 || properties->code == 23007);
+}
+
+BulkUpsert::BulkUpsert(Instance& instance,
+                       std::string target,
+                       std::shared_ptr<MemoryAccount> memory,
+                       options opts)
+  : _instance(instance)
+  , _statement("UPSERT INTO " + target + " ($1)")
+  , _memory(std::move(memory))
+  , _options(opts)
+{
+}
+
+void
+BulkUpsert::add(const std::string& document)
+{
+  // A document which does not fit into a batch on its own still gets one.
+  if (_batches.empty() ||
+      (_batches.back().documents > 0 &&
+       _statement.size() + _batches.back().documentsJson.size() + document.size() + 2 >
+         _options.batchBytes)) {
+    closeBatch();
+    auto& next = _batches.emplace_back();
+    next.firstDocument = _documents;
+    next.documentsJson = "[";
+  }
+
+  auto& current = _batches.back();
+  if (current.documents > 0) {
+    current.documentsJson += ',';
+  }
+  current.documentsJson += document;
+  current.documents++;
+  _documents++;
+}
+
+bool
+BulkUpsert::addEncoded(const std::string& document)
+{
+  // The bytes end up verbatim in the request body, so they have to be checked.
+  try {
+    if (!tao::json::from_string(document).is_object()) {
+      return false;
+    }
+  } catch (const std::exception&) {
+    return false;
+  }
+  add(document);
+  return true;
+}
+
+void
+BulkUpsert::closeBatch()
+{
+  if (_batches.empty()) {
+    return;
+  }
+  auto& current = _batches.back();
+  current.documentsJson += ']';
+  current.bytes = current.documentsJson.size();
+  current.charge = MemoryAccount::Charge(_memory, current.bytes);
+}
+
+void
+BulkUpsert::start(handler_type&& handler)
+{
+  closeBatch();
+  _handler = std::move(handler);
+  if (_batches.empty()) {
+    auto finished = std::move(_handler);
+    finished({});
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (std::size_t i = 0; i < _batches.size(); ++i) {
+      _queue.push_back(i);
+    }
+  }
+  dispatch();
+}
+
+void
+BulkUpsert::dispatch()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (_inFlight < _options.concurrency && !_queue.empty()) {
+    auto index = _queue.front();
+    _queue.pop_front();
+    _inFlight++;
+
+    auto& current = _batches[index];
+    current.attempts++;
+    couchbase::core::columnar::query_options queryOptions{};
+    queryOptions.statement = _statement;
+    queryOptions.positional_parameters.emplace_back(std::string(current.documentsJson));
+    queryOptions.timeout = _options.timeout;
+    lock.unlock();
+
+    auto resp = _instance._agent.execute_query(
+      queryOptions,
+      [self = shared_from_this(), index](couchbase::core::columnar::query_result resp,
+                                         couchbase::core::columnar::error err) {
+        if (err.ec) {
+          return self->onResponse(index, std::move(err));
+        }
+        self->drain(index,
+                    std::make_shared<couchbase::core::columnar::query_result>(std::move(resp)));
+      });
+
+    lock.lock();
+    if (!resp.has_value() && settleLocked(index, resp.error())) {
+      // only possible for the very last batch, nothing else is in flight
+      lock.unlock();
+      auto finished = std::move(_handler);
+      finished(std::move(_batches));
+      return;
+    }
+  }
+}
+
+void
+BulkUpsert::drain(std::size_t index,
+                  std::shared_ptr<couchbase::core::columnar::query_result> result)
+{
+  // UPSERT statements do not return any rows, the result only needs to be read
+  // to the end to find out whether the statement failed along the way.
+  result->next_row(
+    [self = shared_from_this(), index, result](
+      std::variant<std::monostate,
+                   couchbase::core::columnar::query_result_row,
+                   couchbase::core::columnar::query_result_end> resp,
+      couchbase::core::columnar::error err) mutable {
+      if (std::holds_alternative<couchbase::core::columnar::query_result_row>(resp)) {
+        return self->drain(index, std::move(result));
+      }
+      self->onResponse(index, std::move(err));
+    });
+}
+
+void
+BulkUpsert::onResponse(std::size_t index, couchbase::core::columnar::error err)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (!settleLocked(index, std::move(err))) {
+    lock.unlock();
+    return dispatch();
+  }
+  lock.unlock();
+
+  auto finished = std::move(_handler);
+  finished(std::move(_batches));
+}
+
+bool
+BulkUpsert::settleLocked(std::size_t index, couchbase::core::columnar::error err)
+{
+  _inFlight--;
+  auto& current = _batches[index];
+  if (err.ec && current.attempts <= _options.maxRetries && isRetriable(err)) {
+    // Back off exponentially before retrying, the batch goes first once the
+    // timer fires so that it is not held up behind the rest.
+    current.error = std::move(err);
+    auto shift = std::min<std::size_t>(current.attempts - 1, 6);
+    auto backoff = std::min(retry_backoff_min * (1 << shift), retry_backoff_max);
+    auto timer = std::make_shared<asio::steady_timer>(_instance._io);
+    timer->expires_after(backoff);
+    timer->async_wait([self = shared_from_this(), index, timer](std::error_code) {
+      {
+        std::lock_guard<std::mutex> lock(self->_mutex);
+        self->_queue.push_front(index);
+      }
+      self->dispatch();
+    });
+    return false;
+  }
+
+  if (err.ec) {
+    current.error = std::move(err);
+  } else {
+    current.error.reset();
+  }
+  current.documentsJson = {};
+  current.charge = {};
+  return ++_settled == _batches.size();
+}
+
+} // namespace couchnode
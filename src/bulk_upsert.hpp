@@ -0,0 +1,105 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include "memory_account.hpp"
+#include <chrono>
+#include <core/columnar/error.hxx>
+#include <core/columnar/query_result.hxx>
+#include <core/utils/movable_function.hxx>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace couchnode
+{
+
+class Instance;
+
+// Upserts documents into a collection through multi-row UPSERT statements of
+// bounded size, keeping at most a given number of them in flight.  Documents
+// are added (already JSON encoded) on the JS thread before the upsert is
+// started, everything else happens on the IO thread.  Each batch is passed as
+// a JSON array parameter, the documents never become part of the statement.
+// Batches which the service rejected before running them are retried after a
+// backoff.
+class BulkUpsert : public std::enable_shared_from_this<BulkUpsert>
+{
+public:
+  struct options {
+    std::size_t batchBytes{ 1024 * 1024 };
+    std::size_t concurrency{ 4 };
+    std::size_t maxRetries{ 2 };
+    std::optional<std::chrono::milliseconds> timeout{};
+  };
+
+  struct batch {
+    std::size_t firstDocument{ 0 };
+    std::size_t documents{ 0 };
+    std::size_t bytes{ 0 };
+    std::size_t attempts{ 0 };
+    // the error of the last attempt, if it failed
+    std::optional<couchbase::core::columnar::error> error{};
+    // the JSON array of documents, bound as the statement's parameter
+    std::string documentsJson{};
+    MemoryAccount::Charge charge{};
+  };
+
+  using handler_type = couchbase::core::utils::movable_function<void(std::vector<batch>)>;
+
+  // The target must already be a quoted SQL++ collection reference.
+  BulkUpsert(Instance& instance,
+             std::string target,
+             std::shared_ptr<MemoryAccount> memory,
+             options opts);
+
+  void add(const std::string& document);
+
+  // Adds a document which was JSON encoded by the caller, unless it is not a
+  // single JSON object.
+  bool addEncoded(const std::string& document);
+
+  // Dispatches the batches, the handler is invoked once every batch has either
+  // succeeded or run out of retries.
+  void start(handler_type&& handler);
+
+private:
+  void closeBatch();
+  void dispatch();
+  void drain(std::size_t index, std::shared_ptr<couchbase::core::columnar::query_result> result);
+  void onResponse(std::size_t index, couchbase::core::columnar::error err);
+  bool settleLocked(std::size_t index, couchbase::core::columnar::error err);
+
+  Instance& _instance;
+  std::string _statement;
+  std::shared_ptr<MemoryAccount> _memory;
+  options _options;
+  handler_type _handler;
+  std::size_t _documents{ 0 };
+
+  std::mutex _mutex;
+  std::vector<batch> _batches;
+  std::deque<std::size_t> _queue;
+  std::size_t _inFlight{ 0 };
+  std::size_t _settled{ 0 };
+};
+
+} // namespace couchnode
@@ -16,15 +16,27 @@
  */
 
 #include "connection.hpp"
+#include "bulk_upsert.hpp"
 #include "instance.hpp"
+#include "js_strings.hpp"
+#include "json_writer.hpp"
 #include "jstocbpp.hpp"
 #include "query_result.hpp"
+#include "query_trace.hpp"
+#include "row_collector.hpp"
+#include "row_decoder.hpp"
+#include "row_schema.hpp"
+#include <algorithm>
 #include <core/agent_group.hxx>
+#include <core/columnar/error_codes.hxx>
+#include <core/diagnostics.hxx>
 #include <core/operations/management/freeform.hxx>
 #include <core/utils/connection_string.hxx>
 #include <core/utils/duration_parser.hxx>
 #include <core/utils/join_strings.hxx>
 #include <future>
+#include <map>
+#include <mutex>
 #include <type_traits>
 
 namespace couchnode
@@ -55,6 +67,18 @@ Connection::Init(Napi::Env env, Napi::Object exports)
                                       InstanceMethod<&Connection::jsShutdown>("shutdown"),
                                       InstanceMethod<&Connection::jsOpenBucket>("openBucket"),
                                       InstanceMethod<&Connection::jsQuery>("query"),
+                                      InstanceMethod<&Connection::jsBulkUpsert>("bulkUpsert"),
+                                      InstanceMethod<&Connection::jsWarmup>("warmup"),
+                                      InstanceMethod<&Connection::jsNodeScores>("nodeScores"),
+                                      InstanceMethod<&Connection::jsRowBufferUsage>(
+                                        "rowBufferUsage"),
+                                      InstanceMethod<&Connection::jsSlowQueries>("slowQueries"),
+                                      InstanceMethod<&Connection::jsFlushSlowQueries>(
+                                        "flushSlowQueries"),
+                                      InstanceMethod<&Connection::jsQueryStats>("queryStats"),
+                                      InstanceMethod<&Connection::jsResetQueryStats>(
+                                        "resetQueryStats"),
+                                      InstanceMethod<&Connection::jsMemoryUsage>("memoryUsage"),
 
                                       // #region Autogenerated Method Registration
 
@@ -72,8 +96,58 @@ Connection::Connection(const Napi::CallbackInfo& info)
 
 Connection::~Connection()
 {
-  _instance->asyncDestroy();
-  _instance = nullptr;
+  _memory->close(Env());
+  if (_instance) {
+    _instance->asyncDestroy();
+    _instance = nullptr;
+  }
+}
+
+// The settings which apply to the whole instance are part of the key, so that
+// clusters asking for different ones never end up sharing an instance.
+struct InstanceSettings {
+  std::optional<double> hedgeBudget;
+  std::optional<std::size_t> maxBufferedRowBytes;
+};
+
+static std::string
+instanceKey(const std::string& connstr,
+            const couchbase::core::cluster_credentials& creds,
+            const couchbase::core::cluster_options& options,
+            const InstanceSettings& settings)
+{
+  const auto& security = options.security_options;
+  return fmt::format("{}\n{}\n{}\n{}\n{}\n{}\n{}\n{}{}{}{}{}\n{}\n{}\n{}\n{}\n{}\n{}",
+                     connstr,
+                     creds.username,
+                     creds.password,
+                     creds.certificate_path,
+                     creds.key_path,
+                     options.trust_certificate,
+                     options.trust_certificate_value,
+                     security.trust_only_capella,
+                     security.trust_only_pem_file,
+                     security.trust_only_pem_string,
+                     security.trust_only_platform,
+                     !security.trust_only_certificates.empty(),
+                     couchbase::core::utils::join_strings(security.trust_only_certificates, "\n"),
+                     options.dns_config.nameserver(),
+                     options.dns_config.port(),
+                     options.dns_config.timeout().count(),
+                     settings.hedgeBudget.has_value() ? std::to_string(settings.hedgeBudget.value())
+                                                      : "",
+                     settings.maxBufferedRowBytes.has_value()
+                       ? std::to_string(settings.maxBufferedRowBytes.value())
+                       : "");
+}
+
+static Napi::Value
+clusterClosedError(Napi::Env env)
+{
+  return cbpp_to_js(env,
+                    couchbase::core::columnar::error{
+                      couchbase::core::columnar::client_errc::cluster_closed,
+                      "The cluster has been closed" });
 }
 
 Napi::Value
@@ -103,7 +177,6 @@ Connection::jsConnect(const Napi::CallbackInfo& info)
   timeout_config.dispatch_timeout = connstrInfo.options.dispatch_timeout;
   timeout_config.query_timeout = connstrInfo.options.query_timeout;
   timeout_config.management_timeout = connstrInfo.options.management_timeout;
-  this->_instance = new Instance(timeout_config);
 
   if (!securityJsObj.IsNull()) {
     auto jsTrustOnlyCapella = securityJsObj.Get("trustOnlyCapella");
@@ -198,22 +271,65 @@ Connection::jsConnect(const Napi::CallbackInfo& info)
     connstrInfo.options.dns_config = cppDnsConfig;
   }
 
-  auto barrier = std::make_shared<std::promise<std::error_code>>();
-  auto f = barrier->get_future();
-  this->_instance->_cluster.open_in_background(couchbase::core::origin(creds, connstrInfo),
-                                               [barrier](std::error_code ec) mutable {
-                                                 if (ec) {
-                                                   barrier->set_value(ec);
-                                                 } else {
-                                                   barrier->set_value({});
-                                                 }
-                                               });
+  bool shareConnection = false;
+  InstanceSettings settings{};
+  SlowQueryLog::options slowQueryOptions{};
+  if (info.Length() > 4 && info[4].IsObject()) {
+    auto jsConnectOptionsObj = info[4].As<Napi::Object>();
+    shareConnection = jsToCbpp<bool>(jsConnectOptionsObj.Get("shareConnection"));
+    settings.hedgeBudget =
+      jsToCbpp<std::optional<double>>(jsConnectOptionsObj.Get("hedgeBudget"));
+    settings.maxBufferedRowBytes =
+      jsToCbpp<std::optional<std::size_t>>(jsConnectOptionsObj.Get("maxBufferedRowBytes"));
+    if (auto threshold = jsToCbpp<std::optional<std::chrono::milliseconds>>(
+          jsConnectOptionsObj.Get("slowQueryThreshold"));
+        threshold.has_value()) {
+      slowQueryOptions.threshold = threshold.value();
+    }
+    if (auto jsSampleRate = jsConnectOptionsObj.Get("slowQuerySampleRate");
+        !jsSampleRate.IsUndefined()) {
+      slowQueryOptions.sampleRate = jsToCbpp<double>(jsSampleRate);
+    }
+    if (auto jsLogSize = jsConnectOptionsObj.Get("slowQueryLogSize"); !jsLogSize.IsUndefined()) {
+      slowQueryOptions.capacity = jsToCbpp<std::size_t>(jsLogSize);
+    }
+    slowQueryOptions.redact = jsToCbpp<bool>(jsConnectOptionsObj.Get("redactSlowQueries"));
+    if (auto jsMaxFingerprints = jsConnectOptionsObj.Get("maxQueryFingerprints");
+        !jsMaxFingerprints.IsUndefined()) {
+      this->_queryStats->setCapacity(jsToCbpp<std::size_t>(jsMaxFingerprints));
+    }
+  }
+  this->_slowQueryLog->configure(slowQueryOptions);
+
+  bool created = true;
+  if (shareConnection) {
+    this->_instance = Instance::acquire(
+      instanceKey(connstr, creds, connstrInfo.options, settings), timeout_config, created);
+  } else {
+    this->_instance = new Instance(timeout_config);
+  }
+
+  std::error_code open_ec;
+  if (created) {
+    open_ec = this->_instance->open(couchbase::core::origin(creds, connstrInfo));
+  } else {
+    open_ec = this->_instance->waitForOpen();
+  }
 
   auto env = info.Env();
-  auto open_ec = f.get();
   if (open_ec) {
+    // don't hand a failed instance out to anyone else connecting later
+    this->_instance->unshare();
     return cbpp_to_js(env, open_ec);
   }
+  if (created) {
+    if (settings.hedgeBudget.has_value()) {
+      this->_instance->_hedgeBudget.setRatio(settings.hedgeBudget.value());
+    }
+    if (settings.maxBufferedRowBytes.has_value()) {
+      this->_instance->_rowBudget->setLimit(settings.maxBufferedRowBytes.value());
+    }
+  }
   return env.Null();
 }
 
@@ -223,11 +339,21 @@ Connection::jsShutdown(const Napi::CallbackInfo& info)
   auto callbackJsFn = info[0].As<Napi::Function>();
 
   auto cookie = CallCookie(info.Env(), callbackJsFn, "cbShutdownCallback");
-  this->_instance->_cluster.close([cookie = std::move(cookie)]() mutable {
+  auto shutdownHandler = [cookie = std::move(cookie)]() mutable {
     cookie.invoke([](Napi::Env env, Napi::Function callback) {
       callback.Call({ env.Null() });
     });
-  });
+  };
+
+  // Shared instances are only closed once the last connection using them
+  // has released its reference.
+  if (this->_instance) {
+    auto instance = this->_instance;
+    this->_instance = nullptr;
+    instance->asyncDestroy(std::move(shutdownHandler));
+  } else {
+    shutdownHandler();
+  }
 
   return info.Env().Null();
 }
@@ -238,6 +364,10 @@ Connection::jsOpenBucket(const Napi::CallbackInfo& info)
   auto bucketName = info[0].ToString().Utf8Value();
   auto callbackJsFn = info[1].As<Napi::Function>();
 
+  if (!this->_instance) {
+    throw Napi::Error::New(info.Env(), "The cluster has been closed");
+  }
+
   auto cookie = CallCookie(info.Env(), callbackJsFn, "cbOpenBucketCallback");
   this->_instance->_cluster.open_bucket(
     bucketName, [cookie = std::move(cookie)](std::error_code ec) mutable {
@@ -252,27 +382,108 @@ Connection::jsOpenBucket(const Napi::CallbackInfo& info)
 Napi::Value
 Connection::jsQuery(const Napi::CallbackInfo& info)
 {
+  // the query is admitted before its options are converted, which includes
+  // serializing all of its parameters
+  auto startedAt = std::chrono::system_clock::now();
+  auto admitted = QueryTrace::clock::now();
   auto optionsObj = info[0].As<Napi::Object>();
   auto callbackJsFn = info[1].As<Napi::Function>();
 
   auto env = info.Env();
   auto resObj = Napi::Object::New(env);
 
+  if (!this->_instance) {
+    resObj.Set("cppQueryErr", clusterClosedError(env));
+    resObj.Set("cppQueryResult", env.Null());
+    return resObj;
+  }
+
   auto options = js_to_cbpp<couchbase::core::columnar::query_options>(optionsObj);
 
+  Napi::Object execOptionsObj;
+  if (info.Length() > 2 && info[2].IsObject()) {
+    execOptionsObj = info[2].As<Napi::Object>();
+  }
+
+  // Hedging is limited to read-only queries, which are safe to run twice.  Without
+  // an explicit delay the tracked p95 response latency is used, and nothing is
+  // hedged until enough responses have been observed to know it.
+  std::optional<std::chrono::microseconds> hedgeDelay;
+  if (!execOptionsObj.IsEmpty() && options.read_only.value_or(false) &&
+      jsToCbpp<bool>(execOptionsObj.Get("hedge"))) {
+    auto jsHedgeDelay = execOptionsObj.Get("hedgeDelay");
+    if (!jsHedgeDelay.IsUndefined()) {
+      hedgeDelay = jsToCbpp<std::chrono::microseconds>(jsHedgeDelay);
+    } else {
+      hedgeDelay = this->_instance->_queryLatency.percentile(0.95);
+    }
+  }
+
+  // Rows can be collected natively before completing the query, in which case
+  // they are delivered alongside the result in a single completion.
+  std::optional<RowCollector::options> collectOptions;
+  if (!execOptionsObj.IsEmpty() && execOptionsObj.Get("collectRows").IsObject()) {
+    auto collectOptionsObj = execOptionsObj.Get("collectRows").As<Napi::Object>();
+    collectOptions.emplace();
+    if (auto jsKeepRows = collectOptionsObj.Get("keepRows"); !jsKeepRows.IsUndefined()) {
+      collectOptions->keepRows = jsToCbpp<std::size_t>(jsKeepRows);
+    }
+    if (auto jsMaxBytes = collectOptionsObj.Get("maxBytes"); !jsMaxBytes.IsUndefined()) {
+      collectOptions->maxBytes = jsToCbpp<std::size_t>(jsMaxBytes);
+    }
+    collectOptions->drain = jsToCbpp<bool>(collectOptionsObj.Get("drain"));
+  }
+
+  // Rows of queries with a plugin decoder are decoded on the IO thread instead
+  // of being handed to JS as strings.
+  const couchnode_row_decoder* rowDecoder = nullptr;
+  if (!execOptionsObj.IsEmpty() && execOptionsObj.Get("rowDecoder").IsString()) {
+    auto rowDecoderName = jsToCbpp<std::string>(execOptionsObj.Get("rowDecoder"));
+    rowDecoder = findRowDecoder(rowDecoderName);
+    if (rowDecoder == nullptr) {
+      throw Napi::Error::New(env, "No row decoder is registered as '" + rowDecoderName + "'");
+    }
+  }
+
+  // Rows of queries with a schema are decoded on the IO thread and built from a
+  // shared template, rows which do not match are delivered as usual.
+  std::shared_ptr<const RowSchema> rowSchema;
+  if (!execOptionsObj.IsEmpty() && execOptionsObj.Get("schema").IsArray()) {
+    rowSchema =
+      std::make_shared<const RowSchema>(RowSchema::fromJs(execOptionsObj.Get("schema")));
+  }
+
+  // Everything which can reject the query is validated above: the trace would
+  // report a dropped query as abandoned, and the cookie keeps the event loop
+  // alive until it has been invoked.
+  auto trace = std::make_shared<QueryTrace>(
+    options.statement, this->_slowQueryLog, this->_queryStats, startedAt, admitted);
   auto cookie = CallCookie(env, callbackJsFn, "cbQueryCallback");
 
-  auto handler = [](Napi::Env env,
-                    Napi::Function callback,
-                    QueryResult* queryResult,
-                    couchbase::core::columnar::query_result resp,
-                    couchbase::core::columnar::error err) mutable {
+  auto handler = [memory = this->_memory](
+                   Napi::Env env,
+                   Napi::Function callback,
+                   QueryResult* queryResult,
+                   std::shared_ptr<couchbase::core::columnar::query_result> resp,
+                   std::optional<RowCollector::outcome> collected,
+                   couchbase::core::columnar::error err) mutable {
+    memory->report(env);
     try {
       if (err.ec) {
         auto jsErr = cbpp_to_js(env, err);
         callback.Call({ jsErr });
+      } else if (collected.has_value()) {
+        queryResult->setQueryResult(std::move(resp));
+        auto jsCollected = Napi::Object::New(env);
+        auto jsRows = Napi::Array::New(env, collected->rows.size());
+        for (std::size_t i = 0; i < collected->rows.size(); ++i) {
+          jsRows.Set(static_cast<uint32_t>(i), utf8ToJs(env, std::move(collected->rows[i])));
+        }
+        jsCollected.Set("rows", jsRows);
+        jsCollected.Set("complete", cbpp_to_js(env, collected->complete));
+        callback.Call({ env.Null(), jsCollected });
       } else {
-        queryResult->setQueryResult(resp);
+        queryResult->setQueryResult(std::move(resp));
         callback.Call({ env.Null() });
       }
     } catch (const Napi::Error& e) {
@@ -282,20 +493,95 @@ Connection::jsQuery(const Napi::CallbackInfo& info)
 
   auto queryResult = QueryResult::constructor(env).New({});
   auto queryResultPtr = QueryResult::Unwrap(queryResult);
+  auto resultMemory = std::make_shared<MemoryAccount>(this->_memory);
+  queryResultPtr->setMemoryAccount(resultMemory);
+  queryResultPtr->setRowBudget(this->_instance->_rowBudget);
+  queryResultPtr->setTrace(trace);
+  if (rowDecoder != nullptr) {
+    queryResultPtr->setRowDecoder(rowDecoder);
+  }
+  if (rowSchema) {
+    queryResultPtr->setRowSchema(env, std::move(rowSchema));
+  }
 
-  auto resp = this->_instance->_agent.execute_query(
-    options,
-    [queryResultPtr, cookie = std::move(cookie), handler = std::move(handler)](
-      couchbase::core::columnar::query_result resp, couchbase::core::columnar::error err) mutable {
-      cookie.invoke([queryResultPtr,
-                     handler = std::move(handler),
-                     resp = std::move(resp),
-                     err = std::move(err)](Napi::Env env, Napi::Function callback) mutable {
-        handler(env, callback, queryResultPtr, std::move(resp), std::move(err));
-      });
-    });
+  auto instance = this->_instance;
+  auto start = std::chrono::steady_clock::now();
+  instance->_hedgeBudget.onRequest();
+  HedgedQuery::handler_type queryHandler =
+    [instance,
+     start,
+     trace,
+     queryResultPtr,
+     resultMemory,
+     collectOptions,
+     cookie = std::move(cookie),
+     handler = std::move(handler)](couchbase::core::columnar::query_result resp,
+                                   couchbase::core::columnar::error err) mutable {
+      if (!err.ec) {
+        instance->_queryLatency.record(std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start));
+      }
+      trace->onResponse(err);
+
+      auto result = std::make_shared<couchbase::core::columnar::query_result>(std::move(resp));
+      if (err.ec || !collectOptions.has_value()) {
+        cookie.invoke([queryResultPtr,
+                       trace,
+                       queuedAt = QueryTrace::clock::now(),
+                       handler = std::move(handler),
+                       result = std::move(result),
+                       err = std::move(err)](Napi::Env env, Napi::Function callback) mutable {
+          trace->onJsCallback(queuedAt);
+          handler(env, callback, queryResultPtr, std::move(result), {}, std::move(err));
+        });
+        return;
+      }
+
+      RowCollector::collect(
+        result,
+        trace,
+        resultMemory,
+        instance->_rowBudget,
+        collectOptions.value(),
+        [queryResultPtr,
+         result,
+         trace,
+         cookie = std::move(cookie),
+         handler = std::move(handler)](RowCollector::outcome collected) mutable {
+          auto err = std::move(collected.err);
+          cookie.invoke([queryResultPtr,
+                         trace = std::move(trace),
+                         queuedAt = QueryTrace::clock::now(),
+                         handler = std::move(handler),
+                         result = std::move(result),
+                         collected = std::move(collected),
+                         err = std::move(err)](Napi::Env env, Napi::Function callback) mutable {
+            trace->onJsCallback(queuedAt);
+            handler(env,
+                    callback,
+                    queryResultPtr,
+                    std::move(result),
+                    std::move(collected),
+                    std::move(err));
+          });
+        });
+    };
+
+  tl::expected<std::shared_ptr<couchbase::core::pending_operation>,
+               couchbase::core::columnar::error>
+    resp;
+  // marked before handing the query over, its response can arrive on the IO
+  // thread before execute_query returns
+  trace->onDispatched();
+  if (hedgeDelay.has_value()) {
+    resp = HedgedQuery::execute(
+      *instance, std::move(options), hedgeDelay.value(), std::move(queryHandler));
+  } else {
+    resp = instance->_agent.execute_query(options, std::move(queryHandler));
+  }
 
   if (!resp.has_value()) {
+    trace->onDispatchFailed(resp.error());
     resObj.Set("cppQueryErr", cbpp_to_js(env, resp.error()));
     resObj.Set("cppQueryResult", env.Null());
     return resObj;
@@ -306,4 +592,326 @@ Connection::jsQuery(const Napi::CallbackInfo& info)
   return resObj;
 }
 
+static std::string
+quoteIdentifier(Napi::Env env, const std::string& name)
+{
+  if (name.empty() || name.find('`') != std::string::npos) {
+    throw Napi::TypeError::New(env, "Invalid identifier '" + name + "'");
+  }
+  return "`" + name + "`";
+}
+
+Napi::Value
+Connection::jsBulkUpsert(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  auto optionsObj = info[0].As<Napi::Object>();
+  auto docsArr = info[1].As<Napi::Array>();
+  auto callbackJsFn = info[2].As<Napi::Function>();
+
+  if (!this->_instance) {
+    callbackJsFn.Call({ clusterClosedError(env) });
+    return env.Null();
+  }
+
+  auto target = quoteIdentifier(env, jsToCbpp<std::string>(optionsObj.Get("database"))) + "." +
+                quoteIdentifier(env, jsToCbpp<std::string>(optionsObj.Get("scope"))) + "." +
+                quoteIdentifier(env, jsToCbpp<std::string>(optionsObj.Get("collection")));
+
+  BulkUpsert::options opts;
+  if (auto jsBatchBytes = optionsObj.Get("batchBytes"); !jsBatchBytes.IsUndefined()) {
+    opts.batchBytes = jsToCbpp<std::size_t>(jsBatchBytes);
+  }
+  if (auto jsConcurrency = optionsObj.Get("concurrency"); !jsConcurrency.IsUndefined()) {
+    opts.concurrency = std::max<std::size_t>(jsToCbpp<std::size_t>(jsConcurrency), 1);
+  }
+  if (auto jsMaxRetries = optionsObj.Get("maxRetries"); !jsMaxRetries.IsUndefined()) {
+    opts.maxRetries = jsToCbpp<std::size_t>(jsMaxRetries);
+  }
+  if (auto jsTimeout = optionsObj.Get("timeout"); !jsTimeout.IsUndefined()) {
+    opts.timeout = jsToCbpp<std::chrono::milliseconds>(jsTimeout);
+  }
+
+  // Documents are encoded up front on the JS thread, Buffers and Uint8Arrays are
+  // taken to already hold JSON encoded objects.
+  auto bulk =
+    std::make_shared<BulkUpsert>(*this->_instance, std::move(target), this->_memory, opts);
+  for (uint32_t i = 0; i < docsArr.Length(); ++i) {
+    Napi::HandleScope scope(env);
+    auto jsDoc = docsArr.Get(i);
+    if (js_to_cbpp_t<std::string>::isUtf8Bytes(jsDoc)) {
+      if (!bulk->addEncoded(jsToCbpp<std::string>(jsDoc))) {
+        throw Napi::TypeError::New(
+          env, "Document " + std::to_string(i) + " is not a JSON encoded object");
+      }
+    } else {
+      bulk->add(JsonWriter::serialize(jsDoc));
+    }
+  }
+
+  bulk->start([cookie = CallCookie(env, callbackJsFn, "cbBulkUpsertCallback")](
+                std::vector<BulkUpsert::batch> batches) mutable {
+    cookie.invoke([batches = std::move(batches)](Napi::Env env, Napi::Function callback) {
+      std::size_t succeeded = 0;
+      std::size_t failed = 0;
+      auto jsBatches = Napi::Array::New(env, batches.size());
+      for (uint32_t i = 0; i < batches.size(); ++i) {
+        const auto& batch = batches[i];
+        auto jsBatch = Napi::Object::New(env);
+        jsBatch.Set("firstDocument", cbpp_to_js(env, batch.firstDocument));
+        jsBatch.Set("documents", cbpp_to_js(env, batch.documents));
+        jsBatch.Set("bytes", cbpp_to_js(env, batch.bytes));
+        jsBatch.Set("attempts", cbpp_to_js(env, batch.attempts));
+        if (batch.error.has_value()) {
+          jsBatch.Set("error", cbpp_to_js(env, batch.error.value()));
+          failed += batch.documents;
+        } else {
+          jsBatch.Set("error", env.Null());
+          succeeded += batch.documents;
+        }
+        jsBatches.Set(i, jsBatch);
+      }
+
+      auto jsRes = Napi::Object::New(env);
+      jsRes.Set("batches", jsBatches);
+      jsRes.Set("succeeded", cbpp_to_js(env, succeeded));
+      jsRes.Set("failed", cbpp_to_js(env, failed));
+      callback.Call({ env.Null(), jsRes });
+    });
+  });
+
+  return env.Null();
+}
+
+struct WarmupNodeStats {
+  std::vector<std::chrono::microseconds> latencies;
+  std::vector<std::string> errors;
+};
+
+struct WarmupState {
+  WarmupState(CallCookie&& cookie, std::size_t pending)
+    : cookie(std::move(cookie))
+    , pending(pending)
+  {
+  }
+
+  CallCookie cookie;
+  std::mutex mutex;
+  std::size_t pending;
+  std::map<std::string, WarmupNodeStats> nodes;
+};
+
+Napi::Value
+Connection::jsWarmup(const Napi::CallbackInfo& info)
+{
+  auto optionsObj = info[0].As<Napi::Object>();
+  auto callbackJsFn = info[1].As<Napi::Function>();
+
+  if (!this->_instance) {
+    throw Napi::Error::New(info.Env(), "The cluster has been closed");
+  }
+
+  auto connectionsPerNode = jsToCbpp<std::size_t>(optionsObj.Get("connectionsPerNode"));
+  if (connectionsPerNode == 0) {
+    connectionsPerNode = 1;
+  }
+  std::optional<std::chrono::milliseconds> timeout;
+  if (auto jsTimeout = optionsObj.Get("timeout"); !jsTimeout.IsUndefined()) {
+    timeout = jsToCbpp<std::chrono::milliseconds>(jsTimeout);
+  }
+
+  // Every ping round opens a fresh connection to each analytics endpoint
+  // in the current config, issuing them concurrently gives us the requested
+  // number of handshakes per node.
+  auto instance = this->_instance;
+  auto state = std::make_shared<WarmupState>(
+    CallCookie(info.Env(), callbackJsFn, "cbWarmupCallback"), connectionsPerNode);
+  for (std::size_t i = 0; i < connectionsPerNode; ++i) {
+    instance->_cluster.ping(
+      std::nullopt,
+      std::nullopt,
+      { couchbase::core::service_type::analytics },
+      timeout,
+      [instance, state](couchbase::core::diag::ping_result result) {
+        instance->recordPing(result);
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        for (const auto& [type, endpoints] : result.services) {
+          for (const auto& endpoint : endpoints) {
+            auto& node = state->nodes[endpoint.remote];
+            if (endpoint.state == couchbase::core::diag::ping_state::ok) {
+              node.latencies.push_back(endpoint.latency);
+            } else {
+              node.errors.push_back(endpoint.error.value_or("ping failed"));
+            }
+          }
+        }
+        if (--state->pending > 0) {
+          return;
+        }
+        lock.unlock();
+
+        state->cookie.invoke([state](Napi::Env env, Napi::Function callback) {
+          auto jsNodes = Napi::Array::New(env);
+          uint32_t nodeIdx = 0;
+          for (const auto& [endpoint, node] : state->nodes) {
+            auto jsLatencies = Napi::Array::New(env, node.latencies.size());
+            for (uint32_t i = 0; i < node.latencies.size(); ++i) {
+              jsLatencies.Set(i, Napi::Number::New(env, node.latencies[i].count() / 1000.0));
+            }
+
+            auto jsNode = Napi::Object::New(env);
+            jsNode.Set("endpoint", cbpp_to_js(env, endpoint));
+            jsNode.Set("handshakeLatencies", jsLatencies);
+            jsNode.Set("errors", cbpp_to_js(env, node.errors));
+            jsNodes.Set(nodeIdx++, jsNode);
+          }
+
+          auto jsRes = Napi::Object::New(env);
+          jsRes.Set("nodes", jsNodes);
+          callback.Call({ env.Null(), jsRes });
+        });
+      });
+  }
+
+  return info.Env().Null();
+}
+
+Napi::Value
+Connection::jsNodeScores(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  if (!this->_instance) {
+    throw Napi::Error::New(env, "The cluster has been closed");
+  }
+
+  auto nodes = this->_instance->_nodeScores.snapshot();
+  auto jsNodes = Napi::Array::New(env, nodes.size());
+  for (uint32_t i = 0; i < nodes.size(); ++i) {
+    auto jsNode = Napi::Object::New(env);
+    jsNode.Set("endpoint", cbpp_to_js(env, nodes[i].endpoint));
+    jsNode.Set("latencyEwma", cbpp_to_js(env, nodes[i].latencyEwma));
+    jsNode.Set("failureEwma", cbpp_to_js(env, nodes[i].failureEwma));
+    jsNode.Set("samples", cbpp_to_js(env, nodes[i].samples));
+    jsNode.Set("latencySamples", cbpp_to_js(env, nodes[i].latencySamples));
+    jsNode.Set("score", cbpp_to_js(env, nodes[i].score()));
+    jsNodes.Set(i, jsNode);
+  }
+  return jsNodes;
+}
+
+Napi::Value
+Connection::jsRowBufferUsage(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  if (!this->_instance) {
+    throw Napi::Error::New(env, "The cluster has been closed");
+  }
+
+  const auto& budget = this->_instance->_rowBudget;
+  auto resObj = Napi::Object::New(env);
+  resObj.Set("bufferedBytes", cbpp_to_js(env, budget->used()));
+  resObj.Set("limit", cbpp_to_js(env, budget->limit()));
+  resObj.Set("pausedStreams", cbpp_to_js(env, budget->parked()));
+  return resObj;
+}
+
+Napi::Value
+Connection::jsMemoryUsage(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  this->_memory->report(env);
+  auto resObj = Napi::Object::New(env);
+  resObj.Set("bytes", cbpp_to_js(env, this->_memory->bytes()));
+  resObj.Set("results", cbpp_to_js(env, this->_memory->children()));
+  return resObj;
+}
+
+static Napi::Value
+durationToJs(Napi::Env env, std::chrono::microseconds duration)
+{
+  return Napi::Number::New(env, duration.count() / 1000.0);
+}
+
+Napi::Value
+Connection::jsSlowQueries(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  auto records = this->_slowQueryLog->drain();
+  auto jsRecords = Napi::Array::New(env, records.size());
+  for (uint32_t i = 0; i < records.size(); ++i) {
+    const auto& record = records[i];
+    auto jsRecord = Napi::Object::New(env);
+    jsRecord.Set("statement", cbpp_to_js(env, record.statement));
+    jsRecord.Set("requestId", cbpp_to_js(env, record.requestId));
+    auto startedAt = std::chrono::duration_cast<std::chrono::milliseconds>(
+      record.startedAt.time_since_epoch());
+    jsRecord.Set("startedAt", Napi::Number::New(env, static_cast<double>(startedAt.count())));
+    jsRecord.Set("duration", durationToJs(env, record.duration));
+    if (record.serverElapsed.has_value()) {
+      jsRecord.Set("serverElapsed", durationToJs(env, record.serverElapsed.value()));
+    }
+    jsRecord.Set("timings", cbpp_to_js(env, record.timings));
+    jsRecord.Set("rowCount", cbpp_to_js(env, record.rowCount));
+    jsRecord.Set("bytes", cbpp_to_js(env, record.bytes));
+    if (record.error.has_value()) {
+      jsRecord.Set("error", cbpp_to_js(env, record.error.value()));
+    }
+    jsRecord.Set("sampled", cbpp_to_js(env, record.sampled));
+    jsRecords.Set(i, jsRecord);
+  }
+
+  auto resObj = Napi::Object::New(env);
+  resObj.Set("records", jsRecords);
+  resObj.Set("overwritten",
+             Napi::Number::New(env, static_cast<double>(this->_slowQueryLog->overwritten())));
+  return resObj;
+}
+
+Napi::Value
+Connection::jsFlushSlowQueries(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  auto filename = info[0].ToString().Utf8Value();
+  try {
+    return cbpp_to_js(env, this->_slowQueryLog->flush(filename));
+  } catch (const std::system_error& e) {
+    throw Napi::Error::New(env, e.what());
+  }
+}
+
+Napi::Value
+Connection::jsQueryStats(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  auto shapes = this->_queryStats->snapshot();
+  auto jsShapes = Napi::Array::New(env, shapes.size());
+  for (uint32_t i = 0; i < shapes.size(); ++i) {
+    const auto& shape = shapes[i];
+    auto jsShape = Napi::Object::New(env);
+    jsShape.Set("fingerprint", cbpp_to_js(env, fmt::format("{:016x}", shape.fingerprint)));
+    jsShape.Set("statement", cbpp_to_js(env, shape.statement));
+    jsShape.Set("calls", Napi::Number::New(env, static_cast<double>(shape.calls)));
+    jsShape.Set("errors", Napi::Number::New(env, static_cast<double>(shape.errors)));
+    jsShape.Set("rows", Napi::Number::New(env, static_cast<double>(shape.rows)));
+    jsShape.Set("bytes", Napi::Number::New(env, static_cast<double>(shape.bytes)));
+    jsShape.Set("totalTime", durationToJs(env, shape.totalTime));
+    jsShape.Set("meanTime", durationToJs(env, shape.meanTime));
+    jsShape.Set("p99Time", durationToJs(env, shape.p99Time));
+    jsShapes.Set(i, jsShape);
+  }
+
+  auto resObj = Napi::Object::New(env);
+  resObj.Set("statements", jsShapes);
+  resObj.Set("evicted", Napi::Number::New(env, static_cast<double>(this->_queryStats->evicted())));
+  return resObj;
+}
+
+Napi::Value
+Connection::jsResetQueryStats(const Napi::CallbackInfo& info)
+{
+  this->_queryStats->reset();
+  return info.Env().Null();
+}
+
 } // namespace couchnode
@@ -19,6 +19,9 @@
 #include "addondata.hpp"
 #include "instance.hpp"
 #include "jstocbpp.hpp"
+#include "memory_account.hpp"
+#include "query_stats.hpp"
+#include "slow_query_log.hpp"
 #include <core/utils/movable_function.hxx>
 #include <napi.h>
 
@@ -49,7 +52,13 @@ public:
 
   void invoke(FwdFunc&& callback)
   {
-    _ttsf.BlockingCall(new FwdFunc(std::move(callback)));
+    // The environment which issued the call may already be gone (for instance
+    // a worker thread which has been terminated), in which case the callback
+    // is never dispatched and has to be cleaned up here.
+    auto fn = new FwdFunc(std::move(callback));
+    if (_ttsf.BlockingCall(fn) != napi_ok) {
+      delete fn;
+    }
     _ttsf.Release();
   }
 
@@ -79,6 +88,15 @@ public:
   Napi::Value jsShutdown(const Napi::CallbackInfo& info);
   Napi::Value jsOpenBucket(const Napi::CallbackInfo& info);
   Napi::Value jsQuery(const Napi::CallbackInfo& info);
+  Napi::Value jsBulkUpsert(const Napi::CallbackInfo& info);
+  Napi::Value jsWarmup(const Napi::CallbackInfo& info);
+  Napi::Value jsNodeScores(const Napi::CallbackInfo& info);
+  Napi::Value jsRowBufferUsage(const Napi::CallbackInfo& info);
+  Napi::Value jsSlowQueries(const Napi::CallbackInfo& info);
+  Napi::Value jsFlushSlowQueries(const Napi::CallbackInfo& info);
+  Napi::Value jsQueryStats(const Napi::CallbackInfo& info);
+  Napi::Value jsResetQueryStats(const Napi::CallbackInfo& info);
+  Napi::Value jsMemoryUsage(const Napi::CallbackInfo& info);
 
   // #region Autogenerated Method Declarations
 
@@ -124,7 +142,10 @@ private:
               });
   }
 
-  Instance* _instance;
+  Instance* _instance{ nullptr };
+  std::shared_ptr<SlowQueryLog> _slowQueryLog{ std::make_shared<SlowQueryLog>() };
+  std::shared_ptr<QueryStats> _queryStats{ std::make_shared<QueryStats>() };
+  std::shared_ptr<MemoryAccount> _memory{ std::make_shared<MemoryAccount>() };
 };
 
 } // namespace couchnode
@@ -0,0 +1,96 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * C ABI for native row decoder plugins.
+ *
+ * A separate native addon can take over the conversion of query result rows by
+ * exporting a couchnode_row_decoder through a JS external value, which is then
+ * registered with registerRowDecoder() from the columnar module.  Rows of queries
+ * executed with the returned deserializer are handed to the plugin as raw bytes
+ * on an IO thread, and the plugin output is delivered to JS without ever creating
+ * the intermediate JS string.
+ *
+ * This header only depends on Node-API and may be copied into plugin sources.
+ */
+
+#pragma once
+#include <node_api.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COUCHNODE_ROW_DECODER_MAGIC 0x43524431u /* "CRD1" */
+#define COUCHNODE_ROW_DECODER_ABI_VERSION 1u
+
+/*
+ * The result of decoding a single row.  The plugin may store either bytes or a
+ * pointer to any intermediate representation understood by its to_js callback.
+ */
+typedef struct couchnode_row_output {
+  void* data;
+  size_t size;
+} couchnode_row_output;
+
+typedef struct couchnode_row_decoder {
+  /* must be COUCHNODE_ROW_DECODER_MAGIC and COUCHNODE_ROW_DECODER_ABI_VERSION */
+  uint32_t magic;
+  uint32_t abi_version;
+
+  /* unique name of the decoder, used in error messages */
+  const char* name;
+
+  /* opaque plugin state passed to every callback */
+  void* context;
+
+  /*
+   * Decodes a single row.  Called on an IO thread, possibly concurrently for
+   * different queries, so it must be thread safe and must not call into
+   * Node-API.  The row bytes are only valid for the duration of the call.
+   * Returns 0 on success, any other value fails the row with an error which
+   * includes the returned code, in which case the output is discarded without
+   * being released.
+   */
+  int (*decode)(void* context, const char* row, size_t row_size, couchnode_row_output* output);
+
+  /*
+   * Optional.  Builds the JS value delivered for a decoded row, on the JS
+   * thread.  The value must not be undefined or null, which end the row
+   * stream.  When NULL, the output bytes are delivered as a Buffer.
+   */
+  napi_status (*to_js)(void* context,
+                       napi_env env,
+                       const couchnode_row_output* output,
+                       napi_value* result);
+
+  /*
+   * Optional.  Releases the output data, on any thread, since rows which are
+   * dropped before reaching JS are released where they are dropped.  When
+   * provided and to_js is NULL, the
+   * delivered Buffer takes ownership of the output data and releases it once
+   * it is garbage collected.  When NULL, the output data is copied into the
+   * Buffer and must stay valid until the row has been delivered.
+   */
+  void (*release)(void* context, void* data);
+} couchnode_row_decoder;
+
+#ifdef __cplusplus
+}
+#endif
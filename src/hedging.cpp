@@ -0,0 +1,259 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "hedging.hpp"
+#include "instance.hpp"
+#include <algorithm>
+#include <cmath>
+#include <core/columnar/error_codes.hxx>
+
+namespace couchnode
+{
+
+static constexpr std::size_t min_percentile_samples = 20;
+
+LatencyWindow::LatencyWindow(std::size_t capacity)
+  : _capacity(capacity)
+{
+  _samples.reserve(capacity);
+}
+
+void
+LatencyWindow::record(std::chrono::microseconds latency)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_samples.size() < _capacity) {
+    _samples.push_back(latency);
+    return;
+  }
+  _samples[_next] = latency;
+  _next = (_next + 1) % _capacity;
+}
+
+std::optional<std::chrono::microseconds>
+LatencyWindow::percentile(double p) const
+{
+  std::vector<std::chrono::microseconds> samples;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_samples.size() < min_percentile_samples) {
+      return {};
+    }
+    samples = _samples;
+  }
+
+  auto rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(samples.size())));
+  rank = std::clamp<std::size_t>(rank, 1, samples.size());
+  auto nth = samples.begin() + static_cast<std::ptrdiff_t>(rank - 1);
+  std::nth_element(samples.begin(), nth, samples.end());
+  return *nth;
+}
+
+HedgeBudget::HedgeBudget(double ratio, double burst)
+  : _ratio(ratio)
+  , _burst(burst)
+{
+}
+
+void
+HedgeBudget::setRatio(double ratio)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _ratio = ratio;
+}
+
+void
+HedgeBudget::onRequest()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _tokens = std::min(_tokens + _ratio, _burst);
+}
+
+bool
+HedgeBudget::tryAcquire()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_tokens < 1) {
+    return false;
+  }
+  _tokens -= 1;
+  return true;
+}
+
+tl::expected<std::shared_ptr<couchbase::core::pending_operation>, couchbase::core::columnar::error>
+HedgedQuery::execute(Instance& instance,
+                     couchbase::core::columnar::query_options options,
+                     std::chrono::microseconds delay,
+                     handler_type&& handler)
+{
+  auto query = std::make_shared<HedgedQuery>(instance, std::move(options), std::move(handler));
+  {
+    // The timer is shared with the io thread as soon as the first attempt has
+    // been dispatched, so it is only ever touched under the lock.  The wait
+    // handler keeps its own reference so that the timer is always destroyed
+    // while the io context is still alive.
+    std::lock_guard<std::mutex> lock(query->_mutex);
+    query->_timer = std::make_shared<asio::steady_timer>(instance._io);
+    query->_timer->expires_after(delay);
+    query->_timer->async_wait([query, timer = query->_timer](std::error_code ec) {
+      if (ec == asio::error::operation_aborted) {
+        return;
+      }
+      query->launchHedge();
+    });
+  }
+
+  if (auto err = query->dispatch(0); err.has_value()) {
+    std::lock_guard<std::mutex> lock(query->_mutex);
+    query->_completed = true;
+    query->stopTimerLocked();
+    return tl::unexpected(std::move(err.value()));
+  }
+  return query;
+}
+
+HedgedQuery::HedgedQuery(Instance& instance,
+                         couchbase::core::columnar::query_options options,
+                         handler_type&& handler)
+  : _instance(instance)
+  , _options(std::move(options))
+  , _handler(std::move(handler))
+{
+}
+
+void
+HedgedQuery::cancel()
+{
+  std::shared_ptr<couchbase::core::pending_operation> attempts[2];
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cancelled = true;
+    stopTimerLocked();
+    attempts[0] = _attempts[0];
+    attempts[1] = _attempts[1];
+  }
+
+  // cancelling may complete the attempt inline, so it must happen unlocked
+  for (auto& attempt : attempts) {
+    if (attempt) {
+      attempt->cancel();
+    }
+  }
+}
+
+std::optional<couchbase::core::columnar::error>
+HedgedQuery::dispatch(std::size_t attempt)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _outstanding++;
+  }
+
+  auto resp = _instance._agent.execute_query(
+    _options,
+    [self = shared_from_this(), attempt](couchbase::core::columnar::query_result result,
+                                         couchbase::core::columnar::error err) mutable {
+      self->onResponse(attempt, std::move(result), std::move(err));
+    });
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (!resp.has_value()) {
+    _outstanding--;
+    return resp.error();
+  }
+  _attempts[attempt] = resp.value();
+  if (_cancelled || _completed) {
+    // cancel() or the winning response ran before the attempt was stored here,
+    // so neither could have cancelled it
+    lock.unlock();
+    resp.value()->cancel();
+  }
+  return {};
+}
+
+void
+HedgedQuery::launchHedge()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _timer.reset();
+    if (_completed || _cancelled) {
+      return;
+    }
+  }
+  if (!_instance._hedgeBudget.tryAcquire()) {
+    return;
+  }
+
+  // A hedge which cannot be dispatched simply leaves the primary attempt to
+  // answer on its own.
+  dispatch(1);
+}
+
+void
+HedgedQuery::stopTimerLocked()
+{
+  if (_timer) {
+    _timer->cancel();
+    _timer.reset();
+  }
+}
+
+void
+HedgedQuery::onResponse(std::size_t attempt,
+                        couchbase::core::columnar::query_result result,
+                        couchbase::core::columnar::error err)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  _outstanding--;
+  if (_completed) {
+    lock.unlock();
+    if (!err.ec) {
+      result.cancel();
+    }
+    return;
+  }
+  if (err.ec && _outstanding > 0 && !_cancelled) {
+    // the other attempt may still succeed
+    return;
+  }
+
+  // once cancelled, the handler only ever learns about the cancellation, even
+  // if an attempt completed before it could be cancelled
+  auto cancelled = _cancelled;
+  _completed = true;
+  stopTimerLocked();
+  auto loser = _attempts[1 - attempt];
+  auto handler = std::move(_handler);
+  lock.unlock();
+
+  if (loser) {
+    loser->cancel();
+  }
+  if (cancelled) {
+    if (!err.ec) {
+      result.cancel();
+    }
+    handler(std::move(result),
+            couchbase::core::columnar::error{ couchbase::core::columnar::client_errc::canceled,
+                                              "The query was canceled" });
+    return;
+  }
+  handler(std::move(result), std::move(err));
+}
+
+} // namespace couchnode
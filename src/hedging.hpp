@@ -0,0 +1,120 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include <asio/steady_timer.hpp>
+#include <chrono>
+#include <core/columnar/agent.hxx>
+#include <core/columnar/query_options.hxx>
+#include <core/columnar/query_result.hxx>
+#include <core/pending_operation.hxx>
+#include <core/utils/movable_function.hxx>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace couchnode
+{
+
+class Instance;
+
+// Sliding window over the most recently observed query response latencies.
+class LatencyWindow
+{
+public:
+  LatencyWindow(std::size_t capacity = 512);
+
+  void record(std::chrono::microseconds latency);
+
+  // Returns nothing until enough samples have been collected for the
+  // percentile to be meaningful.
+  std::optional<std::chrono::microseconds> percentile(double p) const;
+
+private:
+  std::size_t _capacity;
+  mutable std::mutex _mutex;
+  std::vector<std::chrono::microseconds> _samples;
+  std::size_t _next{ 0 };
+};
+
+// Token bucket limiting hedged requests to a fraction of all requests, so
+// that hedging cannot amplify the load on a cluster which is struggling.
+class HedgeBudget
+{
+public:
+  HedgeBudget(double ratio = 0.05, double burst = 10);
+
+  void setRatio(double ratio);
+
+  // Earns a fraction of a hedge for every request issued.
+  void onRequest();
+
+  bool tryAcquire();
+
+private:
+  std::mutex _mutex;
+  double _ratio;
+  double _burst;
+  double _tokens{ 0 };
+};
+
+// Runs a query and, when no response has arrived within the hedge delay,
+// a duplicate of it.  The first response wins and the other attempt is
+// cancelled.
+class HedgedQuery
+  : public couchbase::core::pending_operation
+  , public std::enable_shared_from_this<HedgedQuery>
+{
+public:
+  using handler_type = couchbase::core::utils::movable_function<
+    void(couchbase::core::columnar::query_result, couchbase::core::columnar::error)>;
+
+  static tl::expected<std::shared_ptr<couchbase::core::pending_operation>,
+                      couchbase::core::columnar::error>
+  execute(Instance& instance,
+          couchbase::core::columnar::query_options options,
+          std::chrono::microseconds delay,
+          handler_type&& handler);
+
+  HedgedQuery(Instance& instance,
+              couchbase::core::columnar::query_options options,
+              handler_type&& handler);
+
+  void cancel() override;
+
+private:
+  std::optional<couchbase::core::columnar::error> dispatch(std::size_t attempt);
+  void launchHedge();
+  void stopTimerLocked();
+  void onResponse(std::size_t attempt,
+                  couchbase::core::columnar::query_result result,
+                  couchbase::core::columnar::error err);
+
+  Instance& _instance;
+  couchbase::core::columnar::query_options _options;
+  handler_type _handler;
+
+  std::mutex _mutex;
+  std::shared_ptr<asio::steady_timer> _timer;
+  std::shared_ptr<couchbase::core::pending_operation> _attempts[2];
+  std::size_t _outstanding{ 0 };
+  bool _completed{ false };
+  bool _cancelled{ false };
+};
+
+} // namespace couchnode
@@ -16,13 +16,19 @@
  */
 
 #include "instance.hpp"
+#include <map>
+#include <mutex>
 
 namespace couchnode
 {
 
+static std::mutex instance_registry_mutex;
+static std::map<std::string, Instance*> instance_registry;
+
 Instance::Instance(couchbase::core::columnar::timeout_config timeout_config)
   : _cluster(couchbase::core::cluster(_io))
   , _agent(couchbase::core::columnar::agent(_io, { { _cluster }, std::move(timeout_config) }))
+  , _openResult(_openBarrier.get_future().share())
 {
   _ioThread = std::thread([this]() {
     try {
@@ -41,10 +47,101 @@ Instance::~Instance()
 {
 }
 
+Instance*
+Instance::acquire(const std::string& key,
+                  couchbase::core::columnar::timeout_config timeout_config,
+                  bool& created)
+{
+  std::lock_guard<std::mutex> lock(instance_registry_mutex);
+  auto it = instance_registry.find(key);
+  if (it != instance_registry.end()) {
+    it->second->_refCount++;
+    created = false;
+    return it->second;
+  }
+
+  auto instance = new Instance(std::move(timeout_config));
+  instance->_registryKey = key;
+  instance_registry.emplace(key, instance);
+  created = true;
+  return instance;
+}
+
+std::error_code
+Instance::open(couchbase::core::origin origin)
+{
+  _cluster.open_in_background(std::move(origin), [this](std::error_code ec) mutable {
+    _openBarrier.set_value(ec);
+  });
+  return waitForOpen();
+}
+
+std::error_code
+Instance::waitForOpen()
+{
+  return _openResult.get();
+}
+
+void
+Instance::unshare()
+{
+  std::lock_guard<std::mutex> lock(instance_registry_mutex);
+  unshareLocked();
+}
+
 void
-Instance::asyncDestroy()
+Instance::unshareLocked()
 {
-  _cluster.close([this]() mutable {
+  if (_registryKey.empty()) {
+    return;
+  }
+  auto it = instance_registry.find(_registryKey);
+  if (it != instance_registry.end() && it->second == this) {
+    instance_registry.erase(it);
+  }
+  _registryKey.clear();
+}
+
+void
+Instance::recordPing(const couchbase::core::diag::ping_result& result)
+{
+  for (const auto& [type, endpoints] : result.services) {
+    for (const auto& endpoint : endpoints) {
+      if (endpoint.state == couchbase::core::diag::ping_state::ok) {
+        _nodeScores.recordSuccess(endpoint.remote, endpoint.latency);
+      } else {
+        _nodeScores.recordFailure(endpoint.remote);
+      }
+    }
+  }
+}
+
+void
+Instance::asyncDestroy(couchbase::core::utils::movable_function<void()> handler)
+{
+  bool lastReference;
+  {
+    // the registry entry has to go in the same critical section as the final
+    // reference, otherwise acquire() could hand out an instance being closed.
+    std::lock_guard<std::mutex> lock(instance_registry_mutex);
+    lastReference = --_refCount == 0;
+    if (lastReference) {
+      unshareLocked();
+    }
+  }
+
+  if (!lastReference) {
+    if (handler) {
+      handler();
+    }
+    return;
+  }
+
+  _cluster.close([this, handler = std::move(handler)]() mutable {
+    if (handler) {
+      handler();
+    }
+
     // We have to run this on a separate thread since the callback itself is
     // actually running from within the io context.
     std::thread([this]() {
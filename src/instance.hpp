@@ -16,11 +16,20 @@
  */
 
 #pragma once
+#include "hedging.hpp"
+#include "node_scores.hpp"
+#include "row_budget.hpp"
 #include <asio/io_context.hpp>
 #include <core/cluster.hxx>
 #include <core/columnar/agent.hxx>
+#include <core/diagnostics.hxx>
 #include <core/logger/logger.hxx>
+#include <core/origin.hxx>
+#include <core/utils/movable_function.hxx>
+#include <future>
 #include <memory>
+#include <string>
+#include <system_error>
 #include <thread>
 
 namespace couchnode
@@ -34,12 +43,44 @@ private:
 public:
   Instance(couchbase::core::columnar::timeout_config timeout_config);
 
-  void asyncDestroy();
+  // Returns the process-wide instance registered under key, taking a reference
+  // to it, or registers a new one.  When created is set the caller is the one
+  // responsible for opening the cluster.
+  static Instance* acquire(const std::string& key,
+                           couchbase::core::columnar::timeout_config timeout_config,
+                           bool& created);
+
+  std::error_code open(couchbase::core::origin origin);
+  std::error_code waitForOpen();
+
+  // Removes this instance from the registry so that it is no longer handed
+  // out to new connections, existing references are unaffected.
+  void unshare();
+
+  // Drops a reference to this instance, the last reference closes the cluster
+  // and destroys the instance.  The handler is invoked once the reference has
+  // been released (and the cluster closed, if it was the last one).
+  void asyncDestroy(couchbase::core::utils::movable_function<void()> handler = {});
+
+  // Feeds the per-endpoint outcome of an analytics ping into the node scores.
+  void recordPing(const couchbase::core::diag::ping_result& result);
 
   asio::io_context _io;
   std::thread _ioThread;
   couchbase::core::cluster _cluster;
   couchbase::core::columnar::agent _agent;
+  NodeScoreboard _nodeScores;
+  LatencyWindow _queryLatency;
+  HedgeBudget _hedgeBudget;
+  std::shared_ptr<RowBudget> _rowBudget{ std::make_shared<RowBudget>() };
+
+private:
+  void unshareLocked();
+
+  std::string _registryKey;
+  std::size_t _refCount{ 1 };
+  std::promise<std::error_code> _openBarrier;
+  std::shared_future<std::error_code> _openResult;
 };
 
 } // namespace couchnode
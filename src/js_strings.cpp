@@ -0,0 +1,187 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "js_strings.hpp"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COUCHNODE_ASCII_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define COUCHNODE_ASCII_NEON 1
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace couchnode
+{
+
+// Strings shorter than this are always copied, the bookkeeping of an external
+// string (a finalizer and a heap allocated owner) costs more than the copy.
+static constexpr std::size_t min_external_string_size = 16 * 1024;
+
+// node_api_create_external_string_latin1 only exists in newer runtimes and
+// outside of the Node-API version this addon is built against, so it is looked
+// up from the host process instead of being linked against.
+using create_external_latin1_fn = napi_status (*)(napi_env env,
+                                                  char* str,
+                                                  std::size_t length,
+                                                  napi_finalize finalize_callback,
+                                                  void* finalize_hint,
+                                                  napi_value* result,
+                                                  bool* copied);
+
+static create_external_latin1_fn
+lookupCreateExternalLatin1()
+{
+  static const char* symbol = "node_api_create_external_string_latin1";
+#ifdef _WIN32
+  auto proc = GetProcAddress(GetModuleHandle(nullptr), symbol);
+#else
+  auto proc = dlsym(RTLD_DEFAULT, symbol);
+#endif
+  return reinterpret_cast<create_external_latin1_fn>(proc);
+}
+
+static create_external_latin1_fn
+createExternalLatin1()
+{
+  static const auto fn = lookupCreateExternalLatin1();
+  return fn;
+}
+
+static inline void
+throwIfFailed(napi_env env, napi_status status)
+{
+  if (status != napi_ok) {
+    throw Napi::Error::New(env);
+  }
+}
+
+bool
+isAscii(const char* data, std::size_t size)
+{
+  auto bytes = reinterpret_cast<const unsigned char*>(data);
+  std::size_t i = 0;
+
+#if defined(COUCHNODE_ASCII_SSE2)
+  // OR together 64 bytes per iteration and test the high bits once, rows are
+  // almost always ASCII so there is no point in exiting early inside a block.
+  for (; i + 64 <= size; i += 64) {
+    auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+    auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i + 16));
+    auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i + 32));
+    auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i + 48));
+    auto combined = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+    if (_mm_movemask_epi8(combined) != 0) {
+      return false;
+    }
+  }
+  for (; i + 16 <= size; i += 16) {
+    auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+    if (_mm_movemask_epi8(block) != 0) {
+      return false;
+    }
+  }
+#elif defined(COUCHNODE_ASCII_NEON)
+  for (; i + 64 <= size; i += 64) {
+    auto a = vld1q_u8(bytes + i);
+    auto b = vld1q_u8(bytes + i + 16);
+    auto c = vld1q_u8(bytes + i + 32);
+    auto d = vld1q_u8(bytes + i + 48);
+    auto combined = vorrq_u8(vorrq_u8(a, b), vorrq_u8(c, d));
+    if (vmaxvq_u8(combined) >= 0x80) {
+      return false;
+    }
+  }
+  for (; i + 16 <= size; i += 16) {
+    if (vmaxvq_u8(vld1q_u8(bytes + i)) >= 0x80) {
+      return false;
+    }
+  }
+#else
+  for (; i + 8 <= size; i += 8) {
+    std::uint64_t word;
+    std::memcpy(&word, bytes + i, sizeof(word));
+    if ((word & 0x8080808080808080ULL) != 0) {
+      return false;
+    }
+  }
+#endif
+
+  for (; i < size; ++i) {
+    if (bytes[i] >= 0x80) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Napi::String
+utf8ToJs(Napi::Env env, const std::string& str)
+{
+  napi_value result;
+  if (isAscii(str.data(), str.size())) {
+    throwIfFailed(env, napi_create_string_latin1(env, str.data(), str.size(), &result));
+  } else {
+    throwIfFailed(env, napi_create_string_utf8(env, str.data(), str.size(), &result));
+  }
+  return Napi::String(env, result);
+}
+
+Napi::String
+utf8ToJs(Napi::Env env, std::string&& str)
+{
+  auto createExternal = createExternalLatin1();
+  if (createExternal == nullptr || str.size() < min_external_string_size ||
+      !isAscii(str.data(), str.size())) {
+    return utf8ToJs(env, static_cast<const std::string&>(str));
+  }
+
+  // The owner moves to the heap so the character data stays put for as long as
+  // V8 references it, the finalizer releases it once the string is collected.
+  auto owner = new std::string(std::move(str));
+  napi_value result;
+  // unused, the finalizer takes care of the owner either way
+  bool copied = false;
+  auto status = createExternal(
+    env,
+    owner->data(),
+    owner->size(),
+    [](napi_env, void*, void* hint) {
+      delete static_cast<std::string*>(hint);
+    },
+    owner,
+    &result,
+    &copied);
+  if (status != napi_ok) {
+    // the runtime refused the data, so the owner is still ours.  When it copies
+    // instead it has already run the finalizer, which released the owner.
+    status = napi_create_string_latin1(env, owner->data(), owner->size(), &result);
+    delete owner;
+    throwIfFailed(env, status);
+  }
+  return Napi::String(env, result);
+}
+
+} // namespace couchnode
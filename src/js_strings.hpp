@@ -0,0 +1,39 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include <cstddef>
+#include <napi.h>
+#include <string>
+
+namespace couchnode
+{
+
+// Returns true when every byte of the buffer is 7-bit ASCII.
+bool isAscii(const char* data, std::size_t size);
+
+// Creates a JS string from UTF-8 encoded text.  Pure ASCII text is handed to V8
+// as a one-byte (latin1) string, which skips the UTF-8 decoder entirely; anything
+// else takes the regular UTF-8 path.
+Napi::String utf8ToJs(Napi::Env env, const std::string& str);
+
+// As above, but large ASCII strings may additionally be created as external
+// strings which take ownership of the buffer instead of copying it, when the
+// running Node-API exports node_api_create_external_string_latin1.
+Napi::String utf8ToJs(Napi::Env env, std::string&& str);
+
+} // namespace couchnode
@@ -0,0 +1,446 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "json_writer.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <fmt/format.h>
+#include <iterator>
+#include <type_traits>
+
+namespace couchnode
+{
+
+static constexpr std::size_t max_json_depth = 1024;
+
+static inline void
+throwIfFailed(napi_env env, napi_status status)
+{
+  if (status != napi_ok) {
+    throw Napi::Error::New(env);
+  }
+}
+
+template<typename T>
+static inline void
+appendInteger(std::string& buffer, T value)
+{
+  char digits[24];
+  auto res = std::to_chars(std::begin(digits), std::end(digits), value);
+  buffer.append(digits, res.ptr);
+}
+
+static inline void
+appendNumber(std::string& buffer, double value)
+{
+  if (!std::isfinite(value)) {
+    buffer += "null";
+    return;
+  }
+  if (value == 0) {
+    // also normalizes -0, which JSON.stringify writes as 0
+    buffer += '0';
+    return;
+  }
+  if (std::trunc(value) == value && std::fabs(value) < 9007199254740992.0) {
+    appendInteger(buffer, static_cast<std::int64_t>(value));
+    return;
+  }
+  fmt::format_to(std::back_inserter(buffer), "{}", value);
+}
+
+template<typename T>
+static inline void
+appendElements(std::string& buffer, const void* data, std::size_t length)
+{
+  auto elements = static_cast<const T*>(data);
+  for (std::size_t i = 0; i < length; ++i) {
+    if (i > 0) {
+      buffer += ',';
+    }
+    if constexpr (std::is_floating_point_v<T>) {
+      appendNumber(buffer, elements[i]);
+    } else {
+      appendInteger(buffer, elements[i]);
+    }
+  }
+}
+
+JsonWriter::JsonWriter(Napi::Env env)
+  : _env(env)
+{
+}
+
+std::string
+JsonWriter::serialize(Napi::Value value)
+{
+  JsonWriter writer(value.Env());
+  writer.write(value);
+  return writer.release();
+}
+
+void
+JsonWriter::write(Napi::Value value)
+{
+  if (value.IsObject()) {
+    loadBuiltins();
+  }
+  if (!writeValue(value, Napi::String::New(_env, ""), 0)) {
+    _buffer += "null";
+  }
+}
+
+std::string
+JsonWriter::release()
+{
+  auto buffer = std::move(_buffer);
+  _buffer.clear();
+  return buffer;
+}
+
+void
+JsonWriter::loadBuiltins()
+{
+  napi_value global;
+  napi_value objectCtor;
+  napi_value booleanPrototype;
+  napi_valuetype bigintType;
+  throwIfFailed(_env, napi_get_global(_env, &global));
+  throwIfFailed(_env, napi_get_named_property(_env, global, "Object", &objectCtor));
+  throwIfFailed(_env,
+                napi_get_named_property(_env, objectCtor, "prototype", &_objectPrototype));
+  throwIfFailed(_env, napi_get_named_property(_env, global, "Number", &_numberCtor));
+  throwIfFailed(_env, napi_get_named_property(_env, global, "String", &_stringCtor));
+  throwIfFailed(_env, napi_get_named_property(_env, global, "Boolean", &_booleanCtor));
+  throwIfFailed(_env,
+                napi_get_named_property(_env, _booleanCtor, "prototype", &booleanPrototype));
+  throwIfFailed(_env,
+                napi_get_named_property(_env, booleanPrototype, "valueOf", &_booleanValueOf));
+  throwIfFailed(_env, napi_get_named_property(_env, global, "BigInt", &_bigintCtor));
+  throwIfFailed(_env, napi_typeof(_env, _bigintCtor, &bigintType));
+  if (bigintType != napi_function) {
+    _bigintCtor = nullptr;
+  }
+}
+
+void
+JsonWriter::unwrapPrimitive(napi_value& value, napi_valuetype& type)
+{
+  // plain objects are by far the most common, don't look any further for them
+  napi_value prototype;
+  bool isPlain;
+  throwIfFailed(_env, napi_get_prototype(_env, value, &prototype));
+  throwIfFailed(_env, napi_strict_equals(_env, prototype, _objectPrototype, &isPlain));
+  if (isPlain) {
+    return;
+  }
+
+  // like JSON.stringify, numbers and strings are converted the way the language
+  // does (honouring valueOf/toString), booleans and bigints take their boxed value
+  bool isInstance;
+  throwIfFailed(_env, napi_instanceof(_env, value, _numberCtor, &isInstance));
+  if (isInstance) {
+    throwIfFailed(_env, napi_coerce_to_number(_env, value, &value));
+    type = napi_number;
+    return;
+  }
+  throwIfFailed(_env, napi_instanceof(_env, value, _stringCtor, &isInstance));
+  if (isInstance) {
+    throwIfFailed(_env, napi_coerce_to_string(_env, value, &value));
+    type = napi_string;
+    return;
+  }
+  throwIfFailed(_env, napi_instanceof(_env, value, _booleanCtor, &isInstance));
+  if (isInstance) {
+    throwIfFailed(_env, napi_call_function(_env, value, _booleanValueOf, 0, nullptr, &value));
+    type = napi_boolean;
+    return;
+  }
+  if (_bigintCtor != nullptr) {
+    throwIfFailed(_env, napi_instanceof(_env, value, _bigintCtor, &isInstance));
+    if (isInstance) {
+      type = napi_bigint;
+    }
+  }
+}
+
+bool
+JsonWriter::writeValue(napi_value value, napi_value key, uint32_t index)
+{
+  napi_valuetype type;
+  throwIfFailed(_env, napi_typeof(_env, value, &type));
+
+  if (type == napi_object) {
+    napi_value toJson;
+    napi_valuetype toJsonType;
+    throwIfFailed(_env, napi_get_named_property(_env, value, "toJSON", &toJson));
+    throwIfFailed(_env, napi_typeof(_env, toJson, &toJsonType));
+    if (toJsonType == napi_function) {
+      if (key == nullptr) {
+        auto indexStr = std::to_string(index);
+        throwIfFailed(_env,
+                      napi_create_string_utf8(_env, indexStr.data(), indexStr.size(), &key));
+      }
+      throwIfFailed(_env, napi_call_function(_env, value, toJson, 1, &key, &value));
+      throwIfFailed(_env, napi_typeof(_env, value, &type));
+    }
+  }
+  if (type == napi_object) {
+    unwrapPrimitive(value, type);
+  }
+
+  switch (type) {
+    case napi_undefined:
+    case napi_function:
+    case napi_symbol:
+      return false;
+    case napi_null:
+      _buffer += "null";
+      return true;
+    case napi_boolean: {
+      bool boolValue;
+      throwIfFailed(_env, napi_get_value_bool(_env, value, &boolValue));
+      _buffer += boolValue ? "true" : "false";
+      return true;
+    }
+    case napi_number: {
+      double numberValue;
+      throwIfFailed(_env, napi_get_value_double(_env, value, &numberValue));
+      appendNumber(_buffer, numberValue);
+      return true;
+    }
+    case napi_string:
+      writeString(value);
+      return true;
+    case napi_bigint:
+      throw Napi::TypeError::New(_env, "Do not know how to serialize a BigInt");
+    case napi_object:
+      writeObject(value);
+      return true;
+    case napi_external:
+      _buffer += "{}";
+      return true;
+  }
+  return false;
+}
+
+void
+JsonWriter::writeObject(napi_value value)
+{
+  bool isArray;
+  throwIfFailed(_env, napi_is_array(_env, value, &isArray));
+  if (isArray) {
+    writeArray(value);
+    return;
+  }
+
+  bool isTypedArray;
+  throwIfFailed(_env, napi_is_typedarray(_env, value, &isTypedArray));
+  if (isTypedArray) {
+    writeTypedArray(value);
+    return;
+  }
+
+  enter(value);
+  napi_value keys;
+  uint32_t length;
+  throwIfFailed(_env,
+                napi_get_all_property_names(
+                  _env,
+                  value,
+                  napi_key_own_only,
+                  static_cast<napi_key_filter>(napi_key_enumerable | napi_key_skip_symbols),
+                  napi_key_numbers_to_strings,
+                  &keys));
+  throwIfFailed(_env, napi_get_array_length(_env, keys, &length));
+
+  _buffer += '{';
+  bool first = true;
+  for (uint32_t i = 0; i < length; ++i) {
+    Napi::HandleScope scope(_env);
+    napi_value key;
+    napi_value property;
+    throwIfFailed(_env, napi_get_element(_env, keys, i, &key));
+    throwIfFailed(_env, napi_get_property(_env, value, key, &property));
+
+    // undefined, function and symbol properties are omitted entirely, so
+    // remember where the member started in case we need to roll it back.
+    auto mark = _buffer.size();
+    if (!first) {
+      _buffer += ',';
+    }
+    writeString(key);
+    _buffer += ':';
+    if (!writeValue(property, key, i)) {
+      _buffer.resize(mark);
+      continue;
+    }
+    first = false;
+  }
+  _buffer += '}';
+  leave();
+}
+
+void
+JsonWriter::writeArray(napi_value value)
+{
+  enter(value);
+  uint32_t length;
+  throwIfFailed(_env, napi_get_array_length(_env, value, &length));
+
+  _buffer += '[';
+  for (uint32_t i = 0; i < length; ++i) {
+    if (i > 0) {
+      _buffer += ',';
+    }
+    Napi::HandleScope scope(_env);
+    napi_value element;
+    throwIfFailed(_env, napi_get_element(_env, value, i, &element));
+    if (!writeValue(element, nullptr, i)) {
+      _buffer += "null";
+    }
+  }
+  _buffer += ']';
+  leave();
+}
+
+void
+JsonWriter::writeTypedArray(napi_value value)
+{
+  napi_typedarray_type type;
+  std::size_t length;
+  void* data;
+  throwIfFailed(_env,
+                napi_get_typedarray_info(_env, value, &type, &length, &data, nullptr, nullptr));
+
+  _buffer += '[';
+  switch (type) {
+    case napi_int8_array:
+      appendElements<std::int8_t>(_buffer, data, length);
+      break;
+    case napi_uint8_array:
+    case napi_uint8_clamped_array:
+      appendElements<std::uint8_t>(_buffer, data, length);
+      break;
+    case napi_int16_array:
+      appendElements<std::int16_t>(_buffer, data, length);
+      break;
+    case napi_uint16_array:
+      appendElements<std::uint16_t>(_buffer, data, length);
+      break;
+    case napi_int32_array:
+      appendElements<std::int32_t>(_buffer, data, length);
+      break;
+    case napi_uint32_array:
+      appendElements<std::uint32_t>(_buffer, data, length);
+      break;
+    case napi_float32_array:
+      appendElements<float>(_buffer, data, length);
+      break;
+    case napi_float64_array:
+      appendElements<double>(_buffer, data, length);
+      break;
+    default:
+      throw Napi::TypeError::New(_env, "Do not know how to serialize a BigInt");
+  }
+  _buffer += ']';
+}
+
+void
+JsonWriter::writeString(napi_value value)
+{
+  std::size_t length;
+  throwIfFailed(_env, napi_get_value_string_utf8(_env, value, nullptr, 0, &length));
+
+  // Decode straight into the output and only fall back to the scratch buffer
+  // when the string actually contains characters which need escaping.
+  _buffer += '"';
+  auto start = _buffer.size();
+  _buffer.resize(start + length + 1);
+  throwIfFailed(_env,
+                napi_get_value_string_utf8(_env, value, &_buffer[start], length + 1, &length));
+  _buffer.resize(start + length);
+
+  auto needsEscape = std::any_of(_buffer.begin() + start, _buffer.end(), [](char c) {
+    return static_cast<unsigned char>(c) < 0x20 || c == '"' || c == '\\';
+  });
+  if (needsEscape) {
+    static const char* hexDigits = "0123456789abcdef";
+    _scratch.assign(_buffer, start, length);
+    _buffer.resize(start);
+    for (char c : _scratch) {
+      switch (c) {
+        case '"':
+          _buffer += "\\\"";
+          break;
+        case '\\':
+          _buffer += "\\\\";
+          break;
+        case '\b':
+          _buffer += "\\b";
+          break;
+        case '\f':
+          _buffer += "\\f";
+          break;
+        case '\n':
+          _buffer += "\\n";
+          break;
+        case '\r':
+          _buffer += "\\r";
+          break;
+        case '\t':
+          _buffer += "\\t";
+          break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20) {
+            _buffer += "\\u00";
+            _buffer += hexDigits[(c >> 4) & 0x0f];
+            _buffer += hexDigits[c & 0x0f];
+          } else {
+            _buffer += c;
+          }
+      }
+    }
+  }
+  _buffer += '"';
+}
+
+void
+JsonWriter::enter(napi_value value)
+{
+  if (_stack.size() >= max_json_depth) {
+    throw Napi::RangeError::New(_env, "Maximum JSON nesting depth exceeded");
+  }
+  for (auto parent : _stack) {
+    bool isSame;
+    throwIfFailed(_env, napi_strict_equals(_env, parent, value, &isSame));
+    if (isSame) {
+      throw Napi::TypeError::New(_env, "Converting circular structure to JSON");
+    }
+  }
+  _stack.push_back(value);
+}
+
+void
+JsonWriter::leave()
+{
+  _stack.pop_back();
+}
+
+} // namespace couchnode
@@ -0,0 +1,67 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include <napi.h>
+#include <string>
+#include <vector>
+
+namespace couchnode
+{
+
+// Serializes JS values straight into a JSON encoded std::string, following the
+// semantics of JSON.stringify (toJSON, skipped undefined/function/symbol
+// properties, non-finite numbers as null, circular structure detection, boxed
+// primitives as their value).  Typed arrays are written as JSON arrays of their
+// numeric elements.
+class JsonWriter
+{
+public:
+  JsonWriter(Napi::Env env);
+
+  static std::string serialize(Napi::Value value);
+
+  void write(Napi::Value value);
+  std::string release();
+
+private:
+  void loadBuiltins();
+  void unwrapPrimitive(napi_value& value, napi_valuetype& type);
+  bool writeValue(napi_value value, napi_value key, uint32_t index);
+  void writeObject(napi_value value);
+  void writeArray(napi_value value);
+  void writeTypedArray(napi_value value);
+  void writeString(napi_value value);
+  void enter(napi_value value);
+  void leave();
+
+  Napi::Env _env;
+  std::string _buffer;
+  std::string _scratch;
+  std::vector<napi_value> _stack;
+
+  // the builtins boxed primitives are recognized by, only loaded once an object
+  // is written
+  napi_value _objectPrototype{ nullptr };
+  napi_value _numberCtor{ nullptr };
+  napi_value _stringCtor{ nullptr };
+  napi_value _booleanCtor{ nullptr };
+  napi_value _booleanValueOf{ nullptr };
+  napi_value _bigintCtor{ nullptr };
+};
+
+} // namespace couchnode
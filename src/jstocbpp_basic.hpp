@@ -18,6 +18,8 @@
 #pragma once
 #include "jstocbpp_cpptypes.hpp"
 #include "jstocbpp_defs.hpp"
+#include "json_writer.hpp"
+#include "query_timings.hpp"
 
 #include <core/cluster.hxx>
 #include <core/columnar/security_options.hxx>
@@ -38,8 +40,13 @@ struct js_to_cbpp_t<couchbase::core::json_string> {
 
   static inline couchbase::core::json_string from_js(Napi::Value jsVal)
   {
-    auto str = js_to_cbpp_t<std::string>::from_js(jsVal);
-    return couchbase::core::json_string(std::move(str));
+    // strings and UTF-8 bytes are already JSON encoded, anything else is
+    // serialized natively
+    if (jsVal.IsString() || js_to_cbpp_t<std::string>::isUtf8Bytes(jsVal)) {
+      auto str = js_to_cbpp_t<std::string>::from_js(jsVal);
+      return couchbase::core::json_string(std::move(str));
+    }
+    return couchbase::core::json_string(JsonWriter::serialize(jsVal));
   }
 };
 
@@ -88,4 +95,29 @@ struct js_to_cbpp_t<couchbase::core::io::dns::dns_config> {
   }
 };
 
+template<>
+struct js_to_cbpp_t<QueryTimings> {
+  static inline Napi::Value to_js(Napi::Env env, const QueryTimings& cppObj)
+  {
+    // unlike plain durations the phases are reported with sub-millisecond
+    // precision, they are often well below a millisecond
+    auto toMillis = [env](std::chrono::microseconds offset) {
+      return Napi::Number::New(env, static_cast<double>(offset.count()) / 1000.0);
+    };
+    auto resObj = Napi::Object::New(env);
+    auto setPhase = [&](const char* name, const std::optional<std::chrono::microseconds>& offset) {
+      if (offset.has_value()) {
+        resObj.Set(name, toMillis(offset.value()));
+      }
+    };
+    setPhase("dispatched", cppObj.dispatched);
+    setPhase("firstByte", cppObj.firstByte);
+    setPhase("firstRow", cppObj.firstRow);
+    setPhase("lastRow", cppObj.lastRow);
+    setPhase("finished", cppObj.finished);
+    resObj.Set("jsQueued", toMillis(cppObj.jsQueued));
+    return resObj;
+  }
+};
+
 } // namespace couchnode
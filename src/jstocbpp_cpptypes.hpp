@@ -16,6 +16,7 @@
  */
 
 #pragma once
+#include "js_strings.hpp"
 #include "jstocbpp_defs.hpp"
 
 #include <map>
@@ -83,7 +84,7 @@ template<>
 struct js_to_cbpp_t<std::string> {
   static inline Napi::Value to_js(Napi::Env env, const std::string& cppObj)
   {
-    return Napi::String::New(env, cppObj);
+    return utf8ToJs(env, cppObj);
   }
 
   static inline std::string from_js(Napi::Value jsVal)
@@ -92,8 +93,20 @@ struct js_to_cbpp_t<std::string> {
       return "";
     }
 
+    // Buffers/Uint8Arrays already hold UTF-8 bytes, take them without transcoding
+    if (isUtf8Bytes(jsVal)) {
+      auto jsBytes = jsVal.As<Napi::Uint8Array>();
+      return std::string(reinterpret_cast<const char*>(jsBytes.Data()), jsBytes.ByteLength());
+    }
+
     return jsVal.ToString().Utf8Value();
   }
+
+  static inline bool isUtf8Bytes(Napi::Value jsVal)
+  {
+    return jsVal.IsTypedArray() &&
+           jsVal.As<Napi::TypedArray>().TypedArrayType() == napi_uint8_array;
+  }
 };
 
 // std::chrono::nanoseconds type
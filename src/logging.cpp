@@ -0,0 +1,228 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "logging.hpp"
+#include <chrono>
+#include <spdlog/pattern_formatter.h>
+
+namespace couchnode
+{
+
+static constexpr auto idle_wait = std::chrono::milliseconds(50);
+
+static std::size_t
+roundUpCapacity(std::size_t capacity)
+{
+  std::size_t rounded = 2;
+  while (rounded < capacity) {
+    rounded <<= 1;
+  }
+  return rounded;
+}
+
+AsyncLogSink::AsyncLogSink(std::shared_ptr<spdlog::sinks::sink> target,
+                           std::size_t capacity,
+                           drop_policy policy)
+  : _slots(new slot[roundUpCapacity(capacity)])
+  , _mask(roundUpCapacity(capacity) - 1)
+  , _policy(policy)
+  , _enabled(target != nullptr)
+  , _target(std::move(target))
+{
+  for (std::size_t i = 0; i <= _mask; ++i) {
+    _slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  _worker = std::thread([this] {
+    run();
+  });
+}
+
+AsyncLogSink::~AsyncLogSink()
+{
+  _stopping.store(true);
+  _wakeup.notify_one();
+  _worker.join();
+}
+
+void
+AsyncLogSink::setTarget(std::shared_ptr<spdlog::sinks::sink> target)
+{
+  std::lock_guard<std::mutex> lock(_targetMutex);
+  if (target && _formatter) {
+    target->set_formatter(_formatter->clone());
+  }
+  if (_target) {
+    _target->flush();
+  }
+  _target = std::move(target);
+  _enabled.store(_target != nullptr);
+}
+
+void
+AsyncLogSink::setDropPolicy(drop_policy policy)
+{
+  _policy.store(policy);
+}
+
+AsyncLogSink::stats
+AsyncLogSink::snapshot() const
+{
+  return {
+    _enqueued.load(std::memory_order_relaxed),
+    _written.load(std::memory_order_relaxed),
+    _dropped.load(std::memory_order_relaxed),
+    _mask + 1,
+  };
+}
+
+void
+AsyncLogSink::log(const spdlog::details::log_msg& msg)
+{
+  if (!_enabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  if (!tryPush(msg)) {
+    if (_policy.load(std::memory_order_relaxed) == drop_policy::drop_newest) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    // Make room by discarding the oldest queued message.  Other producers may
+    // race us for the freed slot, in which case the new message is dropped
+    // after all, which keeps this call bounded.
+    spdlog::details::log_msg_buffer oldest;
+    if (tryPop(oldest)) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!tryPush(msg)) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+
+  _enqueued.fetch_add(1, std::memory_order_relaxed);
+  if (_idle.load(std::memory_order_acquire)) {
+    _wakeup.notify_one();
+  }
+}
+
+void
+AsyncLogSink::flush()
+{
+  // Queued messages are written and flushed by the worker as soon as it has
+  // drained the queue, waiting for that here would block the caller.
+  _wakeup.notify_one();
+}
+
+void
+AsyncLogSink::set_pattern(const std::string& pattern)
+{
+  set_formatter(std::make_unique<spdlog::pattern_formatter>(pattern));
+}
+
+void
+AsyncLogSink::set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter)
+{
+  std::lock_guard<std::mutex> lock(_targetMutex);
+  if (_target) {
+    _target->set_formatter(sink_formatter->clone());
+  }
+  _formatter = std::move(sink_formatter);
+}
+
+bool
+AsyncLogSink::tryPush(const spdlog::details::log_msg& msg)
+{
+  auto pos = _enqueuePos.load(std::memory_order_relaxed);
+  for (;;) {
+    auto& cell = _slots[pos & _mask];
+    auto seq = cell.sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+    if (diff == 0) {
+      if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        cell.msg = spdlog::details::log_msg_buffer(msg);
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = _enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool
+AsyncLogSink::tryPop(spdlog::details::log_msg_buffer& msg)
+{
+  auto pos = _dequeuePos.load(std::memory_order_relaxed);
+  for (;;) {
+    auto& cell = _slots[pos & _mask];
+    auto seq = cell.sequence.load(std::memory_order_acquire);
+    auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+    if (diff == 0) {
+      if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        msg = std::move(cell.msg);
+        cell.sequence.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = _dequeuePos.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void
+AsyncLogSink::run()
+{
+  while (!_stopping.load()) {
+    drain();
+
+    std::unique_lock<std::mutex> lock(_wakeupMutex);
+    _idle.store(true, std::memory_order_release);
+    // re-check after announcing that we are idle so that a message pushed in
+    // between is not left waiting for the timeout
+    if (_enqueuePos.load() == _dequeuePos.load()) {
+      _wakeup.wait_for(lock, idle_wait);
+    }
+    _idle.store(false, std::memory_order_relaxed);
+  }
+  drain();
+}
+
+void
+AsyncLogSink::drain()
+{
+  spdlog::details::log_msg_buffer msg;
+  std::lock_guard<std::mutex> lock(_targetMutex);
+  bool wrote = false;
+  while (tryPop(msg)) {
+    if (_target) {
+      _target->log(msg);
+    }
+    _written.fetch_add(1, std::memory_order_relaxed);
+    wrote = true;
+  }
+  if (wrote && _target) {
+    _target->flush();
+  }
+}
+
+} // namespace couchnode
@@ -0,0 +1,104 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <spdlog/details/log_msg_buffer.h>
+#include <spdlog/sinks/sink.h>
+#include <thread>
+
+namespace couchnode
+{
+
+// Hands log messages over to a background thread through a bounded lock-free
+// queue, so that the threads which log (most importantly the IO thread) never
+// wait on console or file writes.  When the queue is full messages are dropped
+// according to the drop policy rather than blocking the caller.
+class AsyncLogSink : public spdlog::sinks::sink
+{
+public:
+  enum class drop_policy {
+    drop_newest,
+    drop_oldest,
+  };
+
+  struct stats {
+    std::uint64_t enqueued;
+    std::uint64_t written;
+    std::uint64_t dropped;
+    std::size_t capacity;
+  };
+
+  // The capacity is rounded up to the next power of two.
+  AsyncLogSink(std::shared_ptr<spdlog::sinks::sink> target,
+               std::size_t capacity,
+               drop_policy policy);
+  ~AsyncLogSink() override;
+
+  // Swaps the sink messages are written to, a null target discards messages
+  // without queueing them.
+  void setTarget(std::shared_ptr<spdlog::sinks::sink> target);
+  void setDropPolicy(drop_policy policy);
+  stats snapshot() const;
+
+  void log(const spdlog::details::log_msg& msg) override;
+  void flush() override;
+  void set_pattern(const std::string& pattern) override;
+  void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) override;
+
+private:
+  struct slot {
+    std::atomic<std::size_t> sequence;
+    spdlog::details::log_msg_buffer msg;
+  };
+
+  bool tryPush(const spdlog::details::log_msg& msg);
+  bool tryPop(spdlog::details::log_msg_buffer& msg);
+  void run();
+  void drain();
+
+  std::unique_ptr<slot[]> _slots;
+  std::size_t _mask;
+  alignas(64) std::atomic<std::size_t> _enqueuePos{ 0 };
+  alignas(64) std::atomic<std::size_t> _dequeuePos{ 0 };
+
+  std::atomic<drop_policy> _policy;
+  std::atomic<bool> _enabled;
+  std::atomic<std::uint64_t> _enqueued{ 0 };
+  std::atomic<std::uint64_t> _written{ 0 };
+  std::atomic<std::uint64_t> _dropped{ 0 };
+
+  // Only the worker waits on the condition variable, producers merely notify
+  // it when it has gone idle.  A missed notification is covered by the wait
+  // timeout.
+  std::atomic<bool> _idle{ false };
+  std::atomic<bool> _stopping{ false };
+  std::mutex _wakeupMutex;
+  std::condition_variable _wakeup;
+
+  std::mutex _targetMutex;
+  std::shared_ptr<spdlog::sinks::sink> _target;
+  std::unique_ptr<spdlog::formatter> _formatter;
+  std::thread _worker;
+};
+
+} // namespace couchnode
@@ -0,0 +1,139 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "memory_account.hpp"
+#include <cstdlib>
+#include <utility>
+
+namespace couchnode
+{
+
+// Changes smaller than this are held back, so that streaming small rows does
+// not adjust V8's external memory counter for every row.
+static constexpr std::int64_t min_report_delta = 64 * 1024;
+
+MemoryAccount::Charge::Charge(std::shared_ptr<MemoryAccount> account, std::size_t bytes)
+  : _account(std::move(account))
+{
+  add(bytes);
+}
+
+MemoryAccount::Charge::Charge(Charge&& o) noexcept
+  : _account(std::move(o._account))
+  , _bytes(std::exchange(o._bytes, 0))
+{
+}
+
+MemoryAccount::Charge&
+MemoryAccount::Charge::operator=(Charge&& o) noexcept
+{
+  if (this != &o) {
+    if (_account) {
+      _account->adjust(-static_cast<std::int64_t>(_bytes));
+    }
+    _account = std::move(o._account);
+    _bytes = std::exchange(o._bytes, 0);
+  }
+  return *this;
+}
+
+MemoryAccount::Charge::~Charge()
+{
+  if (_account) {
+    _account->adjust(-static_cast<std::int64_t>(_bytes));
+  }
+}
+
+void
+MemoryAccount::Charge::add(std::size_t bytes)
+{
+  if (_account) {
+    _bytes += bytes;
+    _account->adjust(static_cast<std::int64_t>(bytes));
+  }
+}
+
+MemoryAccount::MemoryAccount(std::shared_ptr<MemoryAccount> parent)
+  : _parent(std::move(parent))
+{
+  if (_parent) {
+    _parent->_children.fetch_add(1);
+  }
+}
+
+MemoryAccount::~MemoryAccount()
+{
+  if (_parent) {
+    _parent->adjust(-_bytes.load());
+    _parent->_children.fetch_sub(1);
+  }
+}
+
+void
+MemoryAccount::adjust(std::int64_t delta)
+{
+  _bytes.fetch_add(delta, std::memory_order_relaxed);
+  if (_parent) {
+    _parent->adjust(delta);
+  }
+}
+
+std::int64_t
+MemoryAccount::bytes() const
+{
+  return _bytes.load(std::memory_order_relaxed);
+}
+
+std::size_t
+MemoryAccount::children() const
+{
+  return _children.load();
+}
+
+void
+MemoryAccount::report(Napi::Env env)
+{
+  if (_parent) {
+    return _parent->report(env);
+  }
+  if (_closed) {
+    return;
+  }
+
+  auto delta = bytes() - _reported;
+  if (std::llabs(delta) < min_report_delta) {
+    return;
+  }
+  int64_t adjusted;
+  if (napi_adjust_external_memory(env, delta, &adjusted) == napi_ok) {
+    _reported += delta;
+  }
+}
+
+void
+MemoryAccount::close(Napi::Env env)
+{
+  if (_closed || _parent) {
+    return;
+  }
+  _closed = true;
+  int64_t adjusted;
+  napi_adjust_external_memory(env, -_reported, &adjusted);
+  _reported = 0;
+}
+
+} // namespace couchnode
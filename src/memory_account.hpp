@@ -0,0 +1,86 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <napi.h>
+
+namespace couchnode
+{
+
+// Tracks the native memory held on behalf of a connection (the root account)
+// or one of its query results (child accounts), such as rows which have been
+// received but not yet handed to JS.  Bytes can be charged from any thread and
+// roll up into the root, which reports them to V8 through
+// napi_adjust_external_memory whenever report() is called on the JS thread,
+// so that the garbage collector takes them into account.
+class MemoryAccount
+{
+public:
+  // Charges bytes to an account until it is destroyed.  The charge can grow,
+  // for buffers which are filled incrementally.
+  class Charge
+  {
+  public:
+    Charge() = default;
+    Charge(std::shared_ptr<MemoryAccount> account, std::size_t bytes);
+    Charge(Charge&& o) noexcept;
+    Charge& operator=(Charge&& o) noexcept;
+    Charge(const Charge&) = delete;
+    Charge& operator=(const Charge&) = delete;
+    ~Charge();
+
+    void add(std::size_t bytes);
+
+  private:
+    std::shared_ptr<MemoryAccount> _account;
+    std::size_t _bytes{ 0 };
+  };
+
+  explicit MemoryAccount(std::shared_ptr<MemoryAccount> parent = nullptr);
+  ~MemoryAccount();
+
+  // Adjusts the bytes held by this account (and its parent), from any thread.
+  void adjust(std::int64_t delta);
+
+  std::int64_t bytes() const;
+
+  // The number of child accounts which are still alive.
+  std::size_t children() const;
+
+  // Reports the change in held bytes since the previous report to V8, once it
+  // is large enough to be worth telling about.  Must be called on the JS thread
+  // of the environment the root account belongs to.
+  void report(Napi::Env env);
+
+  // Withdraws everything reported so far, reporting stops afterwards.
+  void close(Napi::Env env);
+
+private:
+  std::shared_ptr<MemoryAccount> _parent;
+  std::atomic<std::int64_t> _bytes{ 0 };
+  std::atomic<std::size_t> _children{ 0 };
+
+  // only used on the JS thread, by the root account
+  std::int64_t _reported{ 0 };
+  bool _closed{ false };
+};
+
+} // namespace couchnode
@@ -0,0 +1,80 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "node_scores.hpp"
+
+namespace couchnode
+{
+
+NodeScoreboard::NodeScoreboard(double decay)
+  : _decay(decay)
+{
+}
+
+void
+NodeScoreboard::recordSuccess(const std::string& endpoint, std::chrono::microseconds latency)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto& node = nodeLocked(endpoint);
+  auto latencyMs = static_cast<double>(latency.count()) / 1000.0;
+  // each average is seeded by its own first observation
+  if (node.latencySamples == 0) {
+    node.latencyEwma = latencyMs;
+  } else {
+    node.latencyEwma += _decay * (latencyMs - node.latencyEwma);
+  }
+  node.failureEwma -= _decay * node.failureEwma;
+  node.latencySamples++;
+  node.samples++;
+}
+
+void
+NodeScoreboard::recordFailure(const std::string& endpoint)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto& node = nodeLocked(endpoint);
+  if (node.samples == 0) {
+    node.failureEwma = 1;
+  } else {
+    node.failureEwma += _decay * (1 - node.failureEwma);
+  }
+  node.samples++;
+}
+
+std::vector<NodeScore>
+NodeScoreboard::snapshot() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::vector<NodeScore> nodes;
+  nodes.reserve(_nodes.size());
+  for (const auto& [endpoint, node] : _nodes) {
+    nodes.push_back(node);
+  }
+  return nodes;
+}
+
+NodeScore&
+NodeScoreboard::nodeLocked(const std::string& endpoint)
+{
+  auto& node = _nodes[endpoint];
+  if (node.endpoint.empty()) {
+    node.endpoint = endpoint;
+  }
+  return node;
+}
+
+} // namespace couchnode
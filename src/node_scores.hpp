@@ -0,0 +1,69 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include <chrono>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace couchnode
+{
+
+struct NodeScore {
+  std::string endpoint;
+  double latencyEwma{ 0 };
+  double failureEwma{ 0 };
+  std::size_t samples{ 0 };
+  // the successful observations, which are the only ones with a latency
+  std::size_t latencySamples{ 0 };
+
+  // Lower is better, the expected latency of a request against the node with
+  // failed attempts weighing in as a doubling of the latency.  A node which has
+  // only ever failed ranks last.
+  double score() const
+  {
+    if (latencySamples == 0) {
+      return std::numeric_limits<double>::infinity();
+    }
+    return latencyEwma * (1 + failureEwma);
+  }
+};
+
+// Tracks an exponentially weighted moving average of the observed latency and
+// failure rate of each analytics node.
+class NodeScoreboard
+{
+public:
+  NodeScoreboard(double decay = 0.2);
+
+  void recordSuccess(const std::string& endpoint, std::chrono::microseconds latency);
+  void recordFailure(const std::string& endpoint);
+
+  std::vector<NodeScore> snapshot() const;
+
+private:
+  NodeScore& nodeLocked(const std::string& endpoint);
+
+  double _decay;
+  mutable std::mutex _mutex;
+  std::map<std::string, NodeScore> _nodes;
+};
+
+} // namespace couchnode
@@ -17,6 +17,7 @@
 
 #include "query_result.hpp"
 #include "connection.hpp"
+#include "js_strings.hpp"
 #include "jstocbpp.hpp"
 
 namespace couchnode
@@ -24,6 +25,7 @@ namespace couchnode
 using result_variant = std::variant<std::monostate,
                                     couchbase::core::columnar::query_result_row,
                                     couchbase::core::columnar::query_result_end>;
+using decoded_variant = std::variant<std::monostate, DecodedRow, ShapedRow>;
 
 void
 QueryResult::Init(Napi::Env env, Napi::Object exports)
@@ -34,6 +36,20 @@ QueryResult::Init(Napi::Env env, Napi::Object exports)
                                       InstanceMethod<&QueryResult::jsNextRow>("nextRow"),
                                       InstanceMethod<&QueryResult::jsCancel>("cancel"),
                                       InstanceMethod<&QueryResult::jsMetadata>("metadata"),
+                                      InstanceMethod<&QueryResult::jsTimings>("timings"),
+                                      InstanceMethod<&QueryResult::jsMemoryUsage>("memoryUsage"),
+                                      InstanceMethod<&QueryResult::jsStartRowRing>("startRowRing"),
+                                      InstanceMethod<&QueryResult::jsRowRingWait>("rowRingWait"),
+                                      InstanceMethod<&QueryResult::jsRowRingResume>(
+                                        "rowRingResume"),
+                                      InstanceMethod<&QueryResult::jsRowRingTakeRow>(
+                                        "rowRingTakeRow"),
+                                      InstanceMethod<&QueryResult::jsRowRingError>("rowRingError"),
+                                      InstanceMethod<&QueryResult::jsStartSpill>("startSpill"),
+                                      InstanceMethod<&QueryResult::jsSpillRead>("spillRead"),
+                                      InstanceMethod<&QueryResult::jsSpillWait>("spillWait"),
+                                      InstanceMethod<&QueryResult::jsSpillDone>("spillDone"),
+                                      InstanceMethod<&QueryResult::jsSpillError>("spillError"),
                                     });
 
   constructor(env) = Napi::Persistent(func);
@@ -48,6 +64,12 @@ QueryResult::QueryResult(const Napi::CallbackInfo& info)
 
 QueryResult::~QueryResult()
 {
+  if (this->row_ring_) {
+    this->row_ring_->detach();
+  }
+  if (this->row_spill_) {
+    this->row_spill_->close();
+  }
 }
 
 void
@@ -57,10 +79,40 @@ QueryResult::setPendingOp(std::shared_ptr<couchbase::core::pending_operation> pe
 }
 
 void
-QueryResult::setQueryResult(couchbase::core::columnar::query_result query_result)
+QueryResult::setQueryResult(std::shared_ptr<couchbase::core::columnar::query_result> query_result)
 {
-  this->result_.reset();
-  this->result_ = std::make_shared<couchbase::core::columnar::query_result>(query_result);
+  this->result_ = std::move(query_result);
+}
+
+void
+QueryResult::setRowBudget(std::shared_ptr<RowBudget> row_budget)
+{
+  this->row_budget_ = std::move(row_budget);
+}
+
+void
+QueryResult::setTrace(std::shared_ptr<QueryTrace> trace)
+{
+  this->trace_ = std::move(trace);
+}
+
+void
+QueryResult::setRowDecoder(const couchnode_row_decoder* row_decoder)
+{
+  this->row_decoder_ = row_decoder;
+}
+
+void
+QueryResult::setRowSchema(Napi::Env env, std::shared_ptr<const RowSchema> row_schema)
+{
+  this->row_template_ = std::make_unique<RowTemplate>(env, *row_schema);
+  this->row_schema_ = std::move(row_schema);
+}
+
+void
+QueryResult::setMemoryAccount(std::shared_ptr<MemoryAccount> memory)
+{
+  this->memory_ = std::move(memory);
 }
 
 Napi::Value
@@ -70,10 +122,19 @@ QueryResult::jsNextRow(const Napi::CallbackInfo& info)
   auto callbackJsFn = info[0].As<Napi::Function>();
   auto cookie = CallCookie(env, callbackJsFn, "cbQueryNextRow");
 
-  auto handler = [](Napi::Env env,
-                    Napi::Function callback,
-                    result_variant resp,
-                    couchbase::core::columnar::error err) mutable {
+  // Rows decoded against a schema are built from the row template, which lives on
+  // this object, so it is kept alive until the row has been delivered.
+  auto rowTemplate = this->row_template_.get();
+  if (rowTemplate != nullptr) {
+    this->Ref();
+  }
+
+  auto handler = [self = this, rowTemplate, memory = this->memory_](
+                   Napi::Env env,
+                   Napi::Function callback,
+                   result_variant resp,
+                   decoded_variant decoded,
+                   couchbase::core::columnar::error err) mutable {
     Napi::Value jsErr, jsRes;
 
     try {
@@ -81,9 +142,17 @@ QueryResult::jsNextRow(const Napi::CallbackInfo& info)
         jsErr = env.Null();
         jsRes = env.Undefined();
       } else if (std::holds_alternative<couchbase::core::columnar::query_result_row>(resp)) {
-        auto row = std::get<couchbase::core::columnar::query_result_row>(resp);
+        // the row content is moved out of the variant, so large ASCII rows can be
+        // handed to V8 as external strings without any copy at all
+        auto& row = std::get<couchbase::core::columnar::query_result_row>(resp);
         jsErr = cbpp_to_js(env, err);
-        jsRes = cbpp_to_js(env, row.content);
+        if (auto pluginRow = std::get_if<DecodedRow>(&decoded); pluginRow) {
+          jsRes = pluginRow->toJs(env);
+        } else if (auto shapedRow = std::get_if<ShapedRow>(&decoded); shapedRow) {
+          jsRes = rowTemplate->toJs(env, std::move(*shapedRow));
+        } else {
+          jsRes = utf8ToJs(env, std::move(row.content));
+        }
       } else { // std::monostate on error
         jsErr = cbpp_to_js(env, err);
         jsRes = env.Null();
@@ -93,16 +162,67 @@ QueryResult::jsNextRow(const Napi::CallbackInfo& info)
       jsRes = env.Null();
     }
 
+    if (rowTemplate != nullptr) {
+      self->Unref();
+    }
+    memory->report(env);
     callback.Call({ jsRes, jsErr });
   };
 
-  this->result_->next_row([cookie = std::move(cookie), handler = std::move(handler)](
-                            result_variant resp, couchbase::core::columnar::error err) mutable {
-    cookie.invoke([handler = std::move(handler), resp = std::move(resp), err = std::move(err)](
-                    Napi::Env env, Napi::Function callback) mutable {
-      handler(env, callback, std::move(resp), std::move(err));
+  auto pull = [result = this->result_,
+               trace = this->trace_,
+               decoder = this->row_decoder_,
+               schema = this->row_schema_,
+               memory = this->memory_,
+               budget = this->row_budget_,
+               cookie = std::move(cookie),
+               handler = std::move(handler)]() mutable {
+    auto& resultRef = *result;
+    resultRef.next_row([result = std::move(result),
+                        trace = std::move(trace),
+                        decoder,
+                        schema = std::move(schema),
+                        memory = std::move(memory),
+                        budget = std::move(budget),
+                        cookie = std::move(cookie),
+                        handler = std::move(handler)](
+                         result_variant resp, couchbase::core::columnar::error err) mutable {
+      trace->onNextRow(resp, err, *result);
+      std::size_t bytes = 0;
+      decoded_variant decoded;
+      if (auto row = std::get_if<couchbase::core::columnar::query_result_row>(&resp); row) {
+        bytes = row->content.size();
+        // decoding happens here on the IO thread, the raw row is not needed after
+        if (decoder != nullptr) {
+          decoded.emplace<DecodedRow>(decoder, row->content);
+          std::string().swap(row->content);
+        } else if (schema) {
+          decoded = schema->decode(std::move(row->content));
+          std::string().swap(row->content);
+        }
+      }
+      // the row counts against the budget until JS has taken it
+      auto reservation = RowBudget::Reservation(std::move(budget), bytes);
+      auto charge = MemoryAccount::Charge(std::move(memory), bytes);
+      cookie.invoke([handler = std::move(handler),
+                     trace = std::move(trace),
+                     queuedAt = QueryTrace::clock::now(),
+                     reservation = std::move(reservation),
+                     charge = std::move(charge),
+                     resp = std::move(resp),
+                     decoded = std::move(decoded),
+                     err = std::move(err)](Napi::Env env, Napi::Function callback) mutable {
+        trace->onJsCallback(queuedAt);
+        handler(env, callback, std::move(resp), std::move(decoded), std::move(err));
+      });
     });
-  });
+  };
+
+  if (this->row_budget_) {
+    this->row_budget_->schedule(std::move(pull));
+  } else {
+    pull();
+  }
   return env.Null();
 }
 
@@ -140,4 +260,137 @@ QueryResult::jsMetadata(const Napi::CallbackInfo& info)
   }
   return env.Null();
 }
+
+Napi::Value
+QueryResult::jsTimings(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  if (!this->trace_) {
+    return env.Null();
+  }
+  return cbpp_to_js(env, this->trace_->timings());
+}
+
+Napi::Value
+QueryResult::jsMemoryUsage(const Napi::CallbackInfo& info)
+{
+  return cbpp_to_js(info.Env(), this->memory_->bytes());
+}
+
+Napi::Value
+QueryResult::jsStartRowRing(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  auto memory = info[0].As<Napi::Uint8Array>();
+  auto notifyJsFn = info[1].As<Napi::Function>();
+
+  if (!this->result_ || this->row_ring_) {
+    throw Napi::Error::New(env, "Row ring can only be started once, before reading any rows");
+  }
+
+  this->row_ring_ = std::make_shared<RowRing>(
+    env, memory, notifyJsFn, this->result_, this->trace_, this->memory_, this->row_budget_);
+  this->row_ring_->start();
+  return env.Null();
+}
+
+Napi::Value
+QueryResult::jsRowRingWait(const Napi::CallbackInfo& info)
+{
+  this->memory_->report(info.Env());
+  return Napi::Boolean::New(info.Env(), this->row_ring_->wait(info.Env()));
+}
+
+Napi::Value
+QueryResult::jsRowRingResume(const Napi::CallbackInfo& info)
+{
+  this->row_ring_->resume();
+  return info.Env().Null();
+}
+
+Napi::Value
+QueryResult::jsRowRingTakeRow(const Napi::CallbackInfo& info)
+{
+  return utf8ToJs(info.Env(), this->row_ring_->takeOversizedRow());
+}
+
+Napi::Value
+QueryResult::jsRowRingError(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  auto err = this->row_ring_->error();
+  if (!err.has_value()) {
+    return env.Null();
+  }
+  return cbpp_to_js(env, err.value());
+}
+
+Napi::Value
+QueryResult::jsStartSpill(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  auto path = info[0].ToString().Utf8Value();
+  auto notifyJsFn = info[1].As<Napi::Function>();
+
+  if (!this->result_ || this->row_ring_ || this->row_spill_) {
+    throw Napi::Error::New(env, "Spilling can only be started once, before reading any rows");
+  }
+
+  this->row_spill_ = std::make_shared<RowSpill>(env,
+                                                std::move(path),
+                                                notifyJsFn,
+                                                this->result_,
+                                                this->trace_,
+                                                this->memory_,
+                                                this->row_budget_);
+  this->row_spill_->start();
+  return env.Null();
+}
+
+Napi::Value
+QueryResult::jsSpillRead(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  auto rows = this->row_spill_->read(info[0].ToNumber().Uint32Value());
+  this->memory_->report(env);
+  if (rows.empty() && this->row_spill_->done()) {
+    if (auto writeError = this->row_spill_->writeError(); writeError.has_value()) {
+      throw Napi::Error::New(env, writeError.value());
+    }
+  }
+
+  auto jsRows = Napi::Array::New(env, rows.size());
+  for (std::size_t i = 0; i < rows.size(); ++i) {
+    jsRows.Set(static_cast<uint32_t>(i), utf8ToJs(env, std::move(rows[i])));
+  }
+  return jsRows;
+}
+
+Napi::Value
+QueryResult::jsSpillWait(const Napi::CallbackInfo& info)
+{
+  return Napi::Boolean::New(info.Env(), this->row_spill_->wait(info.Env()));
+}
+
+Napi::Value
+QueryResult::jsSpillDone(const Napi::CallbackInfo& info)
+{
+  // the file is released as soon as everything has been read back
+  auto done = this->row_spill_->done();
+  if (done) {
+    this->row_spill_->close();
+  }
+  return Napi::Boolean::New(info.Env(), done);
+}
+
+Napi::Value
+QueryResult::jsSpillError(const Napi::CallbackInfo& info)
+{
+  auto env = info.Env();
+  auto err = this->row_spill_->error();
+  if (!err.has_value()) {
+    return env.Null();
+  }
+  return cbpp_to_js(env, err.value());
+}
 } // namespace couchnode
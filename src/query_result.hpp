@@ -18,7 +18,14 @@
 #pragma once
 
 #include "addondata.hpp"
+#include "memory_account.hpp"
 #include "napi.h"
+#include "query_trace.hpp"
+#include "row_budget.hpp"
+#include "row_decoder.hpp"
+#include "row_schema.hpp"
+#include "row_spill.hpp"
+#include "row_ring.hpp"
 #include <core/columnar/query_result.hxx>
 #include <core/pending_operation.hxx>
 
@@ -38,14 +45,39 @@ public:
   ~QueryResult();
 
   void setPendingOp(std::shared_ptr<couchbase::core::pending_operation> pending_op);
-  void setQueryResult(couchbase::core::columnar::query_result query_result);
+  void setQueryResult(std::shared_ptr<couchbase::core::columnar::query_result> query_result);
+  void setRowBudget(std::shared_ptr<RowBudget> row_budget);
+  void setTrace(std::shared_ptr<QueryTrace> trace);
+  void setRowDecoder(const couchnode_row_decoder* row_decoder);
+  void setRowSchema(Napi::Env env, std::shared_ptr<const RowSchema> row_schema);
+  void setMemoryAccount(std::shared_ptr<MemoryAccount> memory);
 
   Napi::Value jsNextRow(const Napi::CallbackInfo& info);
   Napi::Value jsCancel(const Napi::CallbackInfo& info);
   Napi::Value jsMetadata(const Napi::CallbackInfo& info);
+  Napi::Value jsTimings(const Napi::CallbackInfo& info);
+  Napi::Value jsMemoryUsage(const Napi::CallbackInfo& info);
+  Napi::Value jsStartRowRing(const Napi::CallbackInfo& info);
+  Napi::Value jsRowRingWait(const Napi::CallbackInfo& info);
+  Napi::Value jsRowRingResume(const Napi::CallbackInfo& info);
+  Napi::Value jsRowRingTakeRow(const Napi::CallbackInfo& info);
+  Napi::Value jsRowRingError(const Napi::CallbackInfo& info);
+  Napi::Value jsStartSpill(const Napi::CallbackInfo& info);
+  Napi::Value jsSpillRead(const Napi::CallbackInfo& info);
+  Napi::Value jsSpillWait(const Napi::CallbackInfo& info);
+  Napi::Value jsSpillDone(const Napi::CallbackInfo& info);
+  Napi::Value jsSpillError(const Napi::CallbackInfo& info);
 
 private:
   std::shared_ptr<couchbase::core::pending_operation> pending_op_;
   std::shared_ptr<couchbase::core::columnar::query_result> result_;
+  std::shared_ptr<RowBudget> row_budget_;
+  std::shared_ptr<RowRing> row_ring_;
+  std::shared_ptr<RowSpill> row_spill_;
+  std::shared_ptr<QueryTrace> trace_;
+  std::shared_ptr<MemoryAccount> memory_{ std::make_shared<MemoryAccount>() };
+  const couchnode_row_decoder* row_decoder_{ nullptr };
+  std::shared_ptr<const RowSchema> row_schema_;
+  std::unique_ptr<RowTemplate> row_template_;
 };
 } // namespace couchnode
@@ -0,0 +1,170 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "query_stats.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace couchnode
+{
+
+static constexpr double buckets_per_doubling = 4;
+
+void
+LatencyHistogram::record(std::chrono::microseconds latency)
+{
+  std::size_t index = 0;
+  if (latency.count() > 1) {
+    index = static_cast<std::size_t>(std::log2(static_cast<double>(latency.count())) *
+                                     buckets_per_doubling);
+  }
+  _buckets[std::min(index, bucket_count - 1)]++;
+  _count++;
+}
+
+std::chrono::microseconds
+LatencyHistogram::percentile(double p) const
+{
+  if (_count == 0) {
+    return std::chrono::microseconds::zero();
+  }
+
+  auto rank = static_cast<std::uint64_t>(std::ceil(p * static_cast<double>(_count)));
+  std::uint64_t seen = 0;
+  std::size_t index = 0;
+  for (; index < bucket_count; ++index) {
+    seen += _buckets[index];
+    if (seen >= rank) {
+      break;
+    }
+  }
+  // report the upper bound of the bucket
+  return std::chrono::microseconds(static_cast<std::int64_t>(
+    std::exp2(static_cast<double>(index + 1) / buckets_per_doubling)));
+}
+
+QueryStats::QueryStats(std::size_t capacity)
+  : _capacity(capacity)
+{
+}
+
+void
+QueryStats::setCapacity(std::size_t capacity)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _capacity = capacity;
+  while (_entries.size() > _capacity) {
+    evictLocked();
+  }
+}
+
+bool
+QueryStats::enabled() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _capacity > 0;
+}
+
+void
+QueryStats::record(std::uint64_t fingerprint,
+                   std::string_view normalized,
+                   std::chrono::microseconds duration,
+                   std::size_t rows,
+                   std::size_t bytes,
+                   bool failed)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _entries.find(fingerprint);
+  if (it == _entries.end()) {
+    if (_capacity == 0) {
+      return;
+    }
+    if (_entries.size() >= _capacity) {
+      evictLocked();
+    }
+    it = _entries.emplace(fingerprint, entry{}).first;
+    it->second.statement = std::string(normalized);
+    _recency.push_front(fingerprint);
+    it->second.recency = _recency.begin();
+  } else {
+    _recency.splice(_recency.begin(), _recency, it->second.recency);
+  }
+
+  auto& stats = it->second;
+  stats.calls++;
+  if (failed) {
+    stats.errors++;
+  }
+  stats.rows += rows;
+  stats.bytes += bytes;
+  stats.totalTime += duration;
+  stats.latency.record(duration);
+}
+
+std::vector<QueryShapeStats>
+QueryStats::snapshot() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::vector<QueryShapeStats> shapes;
+  shapes.reserve(_entries.size());
+  for (const auto& [fingerprint, stats] : _entries) {
+    shapes.push_back({
+      fingerprint,
+      stats.statement,
+      stats.calls,
+      stats.errors,
+      stats.rows,
+      stats.bytes,
+      stats.totalTime,
+      stats.totalTime / static_cast<std::int64_t>(stats.calls),
+      stats.latency.percentile(0.99),
+    });
+  }
+  std::sort(shapes.begin(), shapes.end(), [](const auto& a, const auto& b) {
+    return a.totalTime > b.totalTime;
+  });
+  return shapes;
+}
+
+std::uint64_t
+QueryStats::evicted() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _evicted;
+}
+
+void
+QueryStats::reset()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _entries.clear();
+  _recency.clear();
+  _evicted = 0;
+}
+
+void
+QueryStats::evictLocked()
+{
+  if (_recency.empty()) {
+    return;
+  }
+  _entries.erase(_recency.back());
+  _recency.pop_back();
+  _evicted++;
+}
+
+} // namespace couchnode
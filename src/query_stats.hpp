@@ -0,0 +1,110 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace couchnode
+{
+
+// Cumulative latency histogram with logarithmic buckets, four per power of
+// two of microseconds, which bounds the error of its percentiles to ~19%.
+class LatencyHistogram
+{
+public:
+  static constexpr std::size_t bucket_count = 128;
+
+  void record(std::chrono::microseconds latency);
+  std::chrono::microseconds percentile(double p) const;
+
+private:
+  std::array<std::uint32_t, bucket_count> _buckets{};
+  std::uint64_t _count{ 0 };
+};
+
+struct QueryShapeStats {
+  std::uint64_t fingerprint;
+  std::string statement;
+  std::uint64_t calls;
+  std::uint64_t errors;
+  std::uint64_t rows;
+  std::uint64_t bytes;
+  std::chrono::microseconds totalTime;
+  std::chrono::microseconds meanTime;
+  std::chrono::microseconds p99Time;
+};
+
+// Aggregates finished queries by the shape of their statement (see
+// normalizeStatement), similar to pg_stat_statements.  The table is bounded,
+// once full the least recently called shape is evicted to make room for a new
+// one.  A capacity of 0 (the default) disables the stats.
+class QueryStats
+{
+public:
+  QueryStats(std::size_t capacity = 0);
+
+  void setCapacity(std::size_t capacity);
+
+  // Whether queries are being aggregated at all.
+  bool enabled() const;
+
+  // The statement is identified by its normalized text and fingerprint (see
+  // normalizeStatement and fingerprintStatement), which are computed by the
+  // caller ahead of time, off the IO thread.
+  void record(std::uint64_t fingerprint,
+              std::string_view normalized,
+              std::chrono::microseconds duration,
+              std::size_t rows,
+              std::size_t bytes,
+              bool failed);
+
+  std::vector<QueryShapeStats> snapshot() const;
+  std::uint64_t evicted() const;
+  void reset();
+
+private:
+  struct entry {
+    std::string statement;
+    std::uint64_t calls{ 0 };
+    std::uint64_t errors{ 0 };
+    std::uint64_t rows{ 0 };
+    std::uint64_t bytes{ 0 };
+    std::chrono::microseconds totalTime{ 0 };
+    LatencyHistogram latency;
+    std::list<std::uint64_t>::iterator recency;
+  };
+
+  void evictLocked();
+
+  mutable std::mutex _mutex;
+  std::size_t _capacity;
+  std::unordered_map<std::uint64_t, entry> _entries;
+  // fingerprints from the most to the least recently called
+  std::list<std::uint64_t> _recency;
+  std::uint64_t _evicted{ 0 };
+};
+
+} // namespace couchnode
@@ -0,0 +1,39 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include <chrono>
+#include <optional>
+
+namespace couchnode
+{
+
+// Client side phases of a query, as offsets from the moment it was issued.
+struct QueryTimings {
+  // handed over to be sent to the cluster
+  std::optional<std::chrono::microseconds> dispatched;
+  // the response started arriving (time to first byte)
+  std::optional<std::chrono::microseconds> firstByte;
+  std::optional<std::chrono::microseconds> firstRow;
+  std::optional<std::chrono::microseconds> lastRow;
+  // the end of the rows or the error was read
+  std::optional<std::chrono::microseconds> finished;
+  // total time completions spent waiting for the JS thread to pick them up
+  std::chrono::microseconds jsQueued{ 0 };
+};
+
+} // namespace couchnode
@@ -0,0 +1,197 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "query_trace.hpp"
+#include "statement.hpp"
+#include <core/columnar/error_codes.hxx>
+
+namespace couchnode
+{
+
+template<typename Duration>
+static std::chrono::microseconds
+toMicros(Duration duration)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration);
+}
+
+QueryTrace::QueryTrace(const std::string& statement,
+                       std::shared_ptr<SlowQueryLog> slowQueryLog,
+                       std::shared_ptr<QueryStats> queryStats,
+                       std::chrono::system_clock::time_point startedAt,
+                       clock::time_point admitted)
+  : _startedAt(startedAt)
+  , _admitted(admitted)
+{
+  // Large statements are expensive to copy, only hold on to one when
+  // something is going to report it.
+  if (slowQueryLog && slowQueryLog->enabled()) {
+    _slowQueryLog = std::move(slowQueryLog);
+  }
+  if (queryStats && queryStats->enabled()) {
+    _queryStats = std::move(queryStats);
+  }
+  auto redact = _slowQueryLog && _slowQueryLog->redacts();
+  if (_queryStats || redact) {
+    _normalized = normalizeStatement(statement);
+    _fingerprint = fingerprintStatement(_normalized);
+  }
+  if (redact) {
+    _statement = _normalized;
+  } else if (_slowQueryLog) {
+    _statement = statement;
+  }
+}
+
+QueryTrace::~QueryTrace()
+{
+  // abandoned or cancelled while rows were still being read
+  if (!_finished.load()) {
+    finish(couchbase::core::columnar::error{ couchbase::core::columnar::client_errc::canceled,
+                                             "The query was abandoned" },
+           nullptr);
+  }
+}
+
+void
+QueryTrace::onDispatched()
+{
+  mark(_dispatched, true);
+}
+
+void
+QueryTrace::onResponse(const couchbase::core::columnar::error& err)
+{
+  mark(_firstByte, true);
+  if (err.ec) {
+    finish(err, nullptr);
+  }
+}
+
+void
+QueryTrace::onDispatchFailed(const couchbase::core::columnar::error& err)
+{
+  finish(err, nullptr);
+}
+
+void
+QueryTrace::onNextRow(const result_variant& resp,
+                      const couchbase::core::columnar::error& err,
+                      const couchbase::core::columnar::query_result& result)
+{
+  if (auto row = std::get_if<couchbase::core::columnar::query_result_row>(&resp); row) {
+    mark(_firstRow, true);
+    mark(_lastRow, false);
+    _rowCount++;
+    _bytes += row->content.size();
+    return;
+  }
+  finish(err, &result);
+}
+
+void
+QueryTrace::onJsCallback(clock::time_point queuedAt)
+{
+  _jsQueued.fetch_add(toMicros(clock::now() - queuedAt).count(), std::memory_order_relaxed);
+}
+
+static std::optional<std::chrono::microseconds>
+phaseOffset(const std::atomic<std::int64_t>& phase)
+{
+  auto offset = phase.load(std::memory_order_relaxed);
+  if (offset < 0) {
+    return {};
+  }
+  return std::chrono::microseconds(offset);
+}
+
+QueryTimings
+QueryTrace::timings() const
+{
+  QueryTimings timings{};
+  timings.dispatched = phaseOffset(_dispatched);
+  timings.firstByte = phaseOffset(_firstByte);
+  timings.firstRow = phaseOffset(_firstRow);
+  timings.lastRow = phaseOffset(_lastRow);
+  timings.finished = phaseOffset(_finishedAt);
+  timings.jsQueued = std::chrono::microseconds(_jsQueued.load(std::memory_order_relaxed));
+  return timings;
+}
+
+void
+QueryTrace::mark(std::atomic<std::int64_t>& phase, bool once)
+{
+  auto offset = toMicros(clock::now() - _admitted).count();
+  if (!once) {
+    phase.store(offset, std::memory_order_relaxed);
+    return;
+  }
+  auto expected = unset;
+  phase.compare_exchange_strong(expected, offset, std::memory_order_relaxed);
+}
+
+void
+QueryTrace::finish(const couchbase::core::columnar::error& err,
+                   const couchbase::core::columnar::query_result* result)
+{
+  if (_finished.exchange(true)) {
+    return;
+  }
+
+  mark(_finishedAt, true);
+  auto duration = std::chrono::microseconds(_finishedAt.load(std::memory_order_relaxed));
+  if (_queryStats) {
+    _queryStats->record(
+      _fingerprint, _normalized, duration, _rowCount, _bytes, static_cast<bool>(err.ec));
+  }
+  if (!_slowQueryLog) {
+    return;
+  }
+
+  std::optional<couchbase::core::columnar::query_metadata> metadata;
+  if (result != nullptr) {
+    metadata = result->metadata();
+  }
+  std::optional<std::chrono::microseconds> serverElapsed;
+  if (metadata.has_value()) {
+    serverElapsed = toMicros(metadata->metrics.elapsed_time);
+  }
+
+  bool sampled = false;
+  if (!_slowQueryLog->shouldRecord(duration, serverElapsed, sampled)) {
+    return;
+  }
+
+  SlowQueryRecord record{};
+  record.statement = _statement;
+  if (metadata.has_value()) {
+    record.requestId = metadata->request_id;
+  }
+  record.startedAt = _startedAt;
+  record.duration = duration;
+  record.serverElapsed = serverElapsed;
+  record.timings = timings();
+  record.rowCount = _rowCount;
+  record.bytes = _bytes;
+  if (err.ec) {
+    record.error = err.ec.message();
+  }
+  record.sampled = sampled;
+  _slowQueryLog->record(std::move(record));
+}
+
+} // namespace couchnode
@@ -0,0 +1,108 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include "query_stats.hpp"
+#include "query_timings.hpp"
+#include "slow_query_log.hpp"
+#include <atomic>
+#include <chrono>
+#include <core/columnar/error.hxx>
+#include <core/columnar/query_result.hxx>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+
+namespace couchnode
+{
+
+// Follows a single query on the client side, from the moment it was issued
+// until its last row has been read by whichever path is reading the rows
+// (streamed, collected natively or through a row ring), and reports the
+// finished query to the slow query log and query stats of its connection.
+// A query which is abandoned before it finished is reported as canceled once
+// its trace goes away.  The statement is only retained while the slow query
+// log or the query stats are enabled, and normalized up front on the JS thread
+// when either needs it that way, so that the IO thread never has to.
+class QueryTrace
+{
+public:
+  using clock = std::chrono::steady_clock;
+  using result_variant = std::variant<std::monostate,
+                                      couchbase::core::columnar::query_result_row,
+                                      couchbase::core::columnar::query_result_end>;
+
+  // admitted is when the query was issued, the phases are measured from there
+  QueryTrace(const std::string& statement,
+             std::shared_ptr<SlowQueryLog> slowQueryLog,
+             std::shared_ptr<QueryStats> queryStats,
+             std::chrono::system_clock::time_point startedAt,
+             clock::time_point admitted);
+  ~QueryTrace();
+
+  // The query has been handed over to be sent.
+  void onDispatched();
+
+  // The initial response of the query, a failed query is finished here.
+  void onResponse(const couchbase::core::columnar::error& err);
+
+  // The query could not be sent at all.
+  void onDispatchFailed(const couchbase::core::columnar::error& err);
+
+  // Every outcome of pulling a row from the result.
+  void onNextRow(const result_variant& resp,
+                 const couchbase::core::columnar::error& err,
+                 const couchbase::core::columnar::query_result& result);
+
+  // A completion which was queued for the JS thread at queuedAt has started
+  // running there.
+  void onJsCallback(clock::time_point queuedAt);
+
+  // Can be called from any thread while the query is running.
+  QueryTimings timings() const;
+
+private:
+  static constexpr std::int64_t unset = -1;
+
+  void mark(std::atomic<std::int64_t>& phase, bool once);
+  void finish(const couchbase::core::columnar::error& err,
+              const couchbase::core::columnar::query_result* result);
+
+  // the statement as reported to the slow query log
+  std::string _statement;
+  std::string _normalized;
+  std::uint64_t _fingerprint{ 0 };
+  std::shared_ptr<SlowQueryLog> _slowQueryLog;
+  std::shared_ptr<QueryStats> _queryStats;
+  std::chrono::system_clock::time_point _startedAt;
+  clock::time_point _admitted;
+  // phase offsets from _admitted in microseconds, or unset
+  std::atomic<std::int64_t> _dispatched{ unset };
+  std::atomic<std::int64_t> _firstByte{ unset };
+  std::atomic<std::int64_t> _firstRow{ unset };
+  std::atomic<std::int64_t> _lastRow{ unset };
+  std::atomic<std::int64_t> _finishedAt{ unset };
+  std::atomic<std::int64_t> _jsQueued{ 0 };
+  std::size_t _rowCount{ 0 };
+  std::size_t _bytes{ 0 };
+  std::atomic_bool _finished{ false };
+};
+
+} // namespace couchnode
@@ -0,0 +1,117 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "row_budget.hpp"
+#include <vector>
+
+namespace couchnode
+{
+
+RowBudget::Reservation::Reservation(std::shared_ptr<RowBudget> budget, std::size_t bytes)
+  : _budget(std::move(budget))
+  , _bytes(bytes)
+{
+  if (_budget) {
+    _budget->add(_bytes);
+  }
+}
+
+RowBudget::Reservation::Reservation(Reservation&& o)
+  : _budget(std::move(o._budget))
+  , _bytes(o._bytes)
+{
+  o._bytes = 0;
+}
+
+RowBudget::Reservation::~Reservation()
+{
+  if (_budget) {
+    _budget->release(_bytes);
+  }
+}
+
+void
+RowBudget::setLimit(std::size_t limit)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _limit = limit;
+}
+
+void
+RowBudget::schedule(pull_type&& pull)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_limit > 0 && _used >= _limit) {
+      _parked.push_back(std::move(pull));
+      return;
+    }
+  }
+  pull();
+}
+
+std::size_t
+RowBudget::used() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _used;
+}
+
+std::size_t
+RowBudget::limit() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _limit;
+}
+
+std::size_t
+RowBudget::parked() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _parked.size();
+}
+
+void
+RowBudget::add(std::size_t bytes)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _used += bytes;
+}
+
+void
+RowBudget::release(std::size_t bytes)
+{
+  std::vector<pull_type> resumed;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _used -= bytes;
+    while (!_parked.empty() && (_limit == 0 || _used < _limit)) {
+      resumed.push_back(std::move(_parked.front()));
+      _parked.pop_front();
+      if (_limit > 0) {
+        // every resumed pull will buffer another row, so only resume as many
+        // as the released bytes can plausibly make room for.
+        break;
+      }
+    }
+  }
+  for (auto& pull : resumed) {
+    pull();
+  }
+}
+
+} // namespace couchnode
@@ -0,0 +1,77 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include <core/utils/movable_function.hxx>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace couchnode
+{
+
+// Bounds the row bytes which have been read from the network but not yet
+// handed to JS, across all the query results of an instance.  Rows are only
+// read from the socket when a result pulls them, so parking the pulls of
+// streams while the budget is exhausted stops reading from their sockets
+// until the JS consumers have caught up.  Every mode of reading rows schedules
+// its pulls here, the row ring, the collector and the spill only hold the rows
+// they buffer natively against it as far as documented on each of them.
+class RowBudget
+{
+public:
+  using pull_type = couchbase::core::utils::movable_function<void()>;
+
+  // Accounts for the bytes of a single pulled row until it is destroyed.  One
+  // is created for every pull, including those which yield no row, as their
+  // release is what resumes parked pulls.
+  class Reservation
+  {
+  public:
+    Reservation(std::shared_ptr<RowBudget> budget, std::size_t bytes);
+    Reservation(Reservation&& o);
+    Reservation(const Reservation&) = delete;
+    ~Reservation();
+
+  private:
+    std::shared_ptr<RowBudget> _budget;
+    std::size_t _bytes;
+  };
+
+  // A limit of zero disables the budget.
+  void setLimit(std::size_t limit);
+
+  // Runs the pull immediately when the budget allows it, otherwise parks it
+  // until enough buffered bytes have been released.
+  void schedule(pull_type&& pull);
+
+  std::size_t used() const;
+  std::size_t limit() const;
+  std::size_t parked() const;
+
+private:
+  void add(std::size_t bytes);
+  void release(std::size_t bytes);
+
+  mutable std::mutex _mutex;
+  std::size_t _limit{ 0 };
+  std::size_t _used{ 0 };
+  std::deque<pull_type> _parked;
+};
+
+} // namespace couchnode
@@ -0,0 +1,129 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "row_collector.hpp"
+
+namespace couchnode
+{
+
+void
+RowCollector::collect(std::shared_ptr<couchbase::core::columnar::query_result> result,
+                      std::shared_ptr<QueryTrace> trace,
+                      std::shared_ptr<MemoryAccount> memory,
+                      std::shared_ptr<RowBudget> budget,
+                      options opts,
+                      handler_type&& handler)
+{
+  auto collector = std::make_shared<RowCollector>(std::move(result),
+                                                  std::move(trace),
+                                                  std::move(memory),
+                                                  std::move(budget),
+                                                  std::move(opts),
+                                                  std::move(handler));
+  collector->pump();
+}
+
+RowCollector::RowCollector(std::shared_ptr<couchbase::core::columnar::query_result> result,
+                           std::shared_ptr<QueryTrace> trace,
+                           std::shared_ptr<MemoryAccount> memory,
+                           std::shared_ptr<RowBudget> budget,
+                           options opts,
+                           handler_type&& handler)
+  : _result(std::move(result))
+  , _trace(std::move(trace))
+  , _budget(std::move(budget))
+  , _options(std::move(opts))
+  , _handler(std::move(handler))
+{
+  _outcome.charge = MemoryAccount::Charge(std::move(memory), 0);
+}
+
+void
+RowCollector::pump()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_pumping) {
+      // the row callback ran inline, let the outer loop issue the next pull
+      _repump = true;
+      return;
+    }
+    _pumping = true;
+  }
+
+  auto self = shared_from_this();
+  while (true) {
+    auto pull = [self]() {
+      self->_result->next_row(
+        [self](result_variant resp, couchbase::core::columnar::error err) mutable {
+          self->onRow(std::move(resp), std::move(err));
+        });
+    };
+    if (_budget) {
+      _budget->schedule(std::move(pull));
+    } else {
+      pull();
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_repump) {
+      _pumping = false;
+      return;
+    }
+    _repump = false;
+  }
+}
+
+void
+RowCollector::onRow(result_variant resp, couchbase::core::columnar::error err)
+{
+  _trace->onNextRow(resp, err, *_result);
+  if (auto row = std::get_if<couchbase::core::columnar::query_result_row>(&resp); row) {
+    if (retaining()) {
+      _outcome.bytes += row->content.size();
+      _outcome.charge.add(row->content.size());
+      _outcome.rows.push_back(std::move(row->content));
+    }
+    if (!_options.drain && !retaining()) {
+      // the remaining rows are left in the result to be streamed
+      return finish();
+    }
+    return pump();
+  }
+
+  if (std::holds_alternative<couchbase::core::columnar::query_result_end>(resp)) {
+    _outcome.complete = true;
+  } else {
+    _outcome.err = std::move(err);
+  }
+  finish();
+}
+
+bool
+RowCollector::retaining() const
+{
+  return _outcome.rows.size() < _options.keepRows && _outcome.bytes < _options.maxBytes;
+}
+
+void
+RowCollector::finish()
+{
+  auto handler = std::move(_handler);
+  handler(std::move(_outcome));
+}
+
+} // namespace couchnode
@@ -0,0 +1,97 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include "memory_account.hpp"
+#include "query_trace.hpp"
+#include "row_budget.hpp"
+#include <core/columnar/error.hxx>
+#include <core/columnar/query_result.hxx>
+#include <core/utils/movable_function.hxx>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace couchnode
+{
+
+// Pulls the rows of a query result on the IO thread without handing them to
+// JS one by one.  Rows are retained until either keepRows rows or maxBytes
+// bytes have been collected, the rest are either discarded (drain) or left in
+// the result for streaming.  Pulls are scheduled through the row budget, but
+// the retained rows are not held against it: they are bounded by maxBytes, and
+// a collection larger than the budget would otherwise never complete.
+class RowCollector : public std::enable_shared_from_this<RowCollector>
+{
+public:
+  struct options {
+    std::size_t keepRows{ std::numeric_limits<std::size_t>::max() };
+    std::size_t maxBytes{ std::numeric_limits<std::size_t>::max() };
+    bool drain{ true };
+  };
+
+  struct outcome {
+    std::vector<std::string> rows;
+    std::size_t bytes{ 0 };
+    bool complete{ false };
+    couchbase::core::columnar::error err{};
+    // accounts for the retained rows until the outcome is dropped
+    MemoryAccount::Charge charge{};
+  };
+
+  using handler_type = couchbase::core::utils::movable_function<void(outcome)>;
+
+  static void collect(std::shared_ptr<couchbase::core::columnar::query_result> result,
+                      std::shared_ptr<QueryTrace> trace,
+                      std::shared_ptr<MemoryAccount> memory,
+                      std::shared_ptr<RowBudget> budget,
+                      options opts,
+                      handler_type&& handler);
+
+  RowCollector(std::shared_ptr<couchbase::core::columnar::query_result> result,
+               std::shared_ptr<QueryTrace> trace,
+               std::shared_ptr<MemoryAccount> memory,
+               std::shared_ptr<RowBudget> budget,
+               options opts,
+               handler_type&& handler);
+
+private:
+  using result_variant = std::variant<std::monostate,
+                                      couchbase::core::columnar::query_result_row,
+                                      couchbase::core::columnar::query_result_end>;
+
+  void pump();
+  void onRow(result_variant resp, couchbase::core::columnar::error err);
+  bool retaining() const;
+  void finish();
+
+  std::shared_ptr<couchbase::core::columnar::query_result> _result;
+  std::shared_ptr<QueryTrace> _trace;
+  std::shared_ptr<RowBudget> _budget;
+  options _options;
+  handler_type _handler;
+  outcome _outcome;
+
+  std::mutex _mutex;
+  bool _pumping{ false };
+  bool _repump{ false };
+};
+
+} // namespace couchnode
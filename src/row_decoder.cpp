@@ -0,0 +1,147 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "row_decoder.hpp"
+#include <fmt/format.h>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace couchnode
+{
+
+// Plugins are process-wide native code, so the registry is shared by every
+// environment (main thread and worker threads) the addon has been loaded into.
+static std::mutex rowDecodersMutex;
+static std::map<std::string, const couchnode_row_decoder*> rowDecoders;
+
+void
+registerRowDecoder(Napi::Env env, const couchnode_row_decoder* decoder)
+{
+  if (decoder->magic != COUCHNODE_ROW_DECODER_MAGIC) {
+    throw Napi::TypeError::New(env, "Value is not a row decoder");
+  }
+  if (decoder->abi_version != COUCHNODE_ROW_DECODER_ABI_VERSION) {
+    throw Napi::Error::New(env,
+                           fmt::format("Row decoder ABI version {} is not supported, expected {}",
+                                       decoder->abi_version,
+                                       COUCHNODE_ROW_DECODER_ABI_VERSION));
+  }
+  if (decoder->name == nullptr || decoder->name[0] == '\0' || decoder->decode == nullptr) {
+    throw Napi::TypeError::New(env, "Row decoder must have a name and a decode function");
+  }
+
+  std::lock_guard<std::mutex> lock(rowDecodersMutex);
+  auto [it, inserted] = rowDecoders.emplace(decoder->name, decoder);
+  if (!inserted && it->second != decoder) {
+    throw Napi::Error::New(
+      env, fmt::format("A different row decoder is already registered as '{}'", decoder->name));
+  }
+}
+
+const couchnode_row_decoder*
+findRowDecoder(const std::string& name)
+{
+  std::lock_guard<std::mutex> lock(rowDecodersMutex);
+  auto it = rowDecoders.find(name);
+  return it != rowDecoders.end() ? it->second : nullptr;
+}
+
+DecodedRow::DecodedRow(const couchnode_row_decoder* decoder, const std::string& row)
+  : _decoder(decoder)
+{
+  _status = _decoder->decode(_decoder->context, row.data(), row.size(), &_output);
+  if (_status != 0) {
+    _output = { nullptr, 0 };
+  }
+}
+
+DecodedRow::DecodedRow(DecodedRow&& other) noexcept
+  : _decoder(other._decoder)
+  , _status(other._status)
+  , _output(std::exchange(other._output, { nullptr, 0 }))
+{
+}
+
+DecodedRow&
+DecodedRow::operator=(DecodedRow&& other) noexcept
+{
+  if (this != &other) {
+    release();
+    _decoder = other._decoder;
+    _status = other._status;
+    _output = std::exchange(other._output, { nullptr, 0 });
+  }
+  return *this;
+}
+
+DecodedRow::~DecodedRow()
+{
+  release();
+}
+
+void
+DecodedRow::release()
+{
+  if (_output.data != nullptr && _decoder->release != nullptr) {
+    _decoder->release(_decoder->context, _output.data);
+  }
+  _output = { nullptr, 0 };
+}
+
+Napi::Value
+DecodedRow::toJs(Napi::Env env)
+{
+  if (_status != 0) {
+    throw Napi::Error::New(
+      env, fmt::format("Row decoder '{}' failed to decode a row ({})", _decoder->name, _status));
+  }
+
+  if (_decoder->to_js != nullptr) {
+    napi_value result;
+    auto status = _decoder->to_js(_decoder->context, env, &_output, &result);
+    release();
+    if (status != napi_ok) {
+      throw Napi::Error::New(env);
+    }
+    return Napi::Value(env, result);
+  }
+
+  if (_output.size == 0) {
+    release();
+    return Napi::Buffer<char>::New(env, 0);
+  }
+  if (_decoder->release == nullptr) {
+    auto buffer =
+      Napi::Buffer<char>::Copy(env, static_cast<const char*>(_output.data), _output.size);
+    _output = { nullptr, 0 };
+    return buffer;
+  }
+
+  // the Buffer takes over the output, it is released once the Buffer is collected
+  auto output = std::exchange(_output, { nullptr, 0 });
+  return Napi::Buffer<char>::New(
+    env,
+    static_cast<char*>(output.data),
+    output.size,
+    [](Napi::Env, char* data, const couchnode_row_decoder* decoder) {
+      decoder->release(decoder->context, data);
+    },
+    _decoder);
+}
+
+} // namespace couchnode
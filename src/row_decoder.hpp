@@ -0,0 +1,56 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include "couchnode_row_decoder.h"
+#include <napi.h>
+#include <string>
+
+namespace couchnode
+{
+
+// Registers a plugin decoder under its name.  Registering the same decoder twice
+// is a no-op, registering a different decoder under a taken name throws.
+void registerRowDecoder(Napi::Env env, const couchnode_row_decoder* decoder);
+
+// Returns the decoder registered under the name, or nullptr if there is none.
+const couchnode_row_decoder* findRowDecoder(const std::string& name);
+
+// A row which has been run through a plugin decoder on the IO thread, waiting to
+// be delivered to JS.  The plugin output is released when the row is dropped
+// without having been delivered.
+class DecodedRow
+{
+public:
+  DecodedRow(const couchnode_row_decoder* decoder, const std::string& row);
+  DecodedRow(DecodedRow&& other) noexcept;
+  DecodedRow& operator=(DecodedRow&& other) noexcept;
+  DecodedRow(const DecodedRow&) = delete;
+  DecodedRow& operator=(const DecodedRow&) = delete;
+  ~DecodedRow();
+
+  Napi::Value toJs(Napi::Env env);
+
+private:
+  void release();
+
+  const couchnode_row_decoder* _decoder;
+  int _status{ 0 };
+  couchnode_row_output _output{ nullptr, 0 };
+};
+
+} // namespace couchnode
@@ -0,0 +1,325 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "row_ring.hpp"
+#include <cstring>
+
+namespace couchnode
+{
+
+static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t) &&
+                std::atomic<int32_t>::is_always_lock_free,
+              "ring buffer header slots must map onto plain int32 values");
+
+static constexpr int32_t ring_state_end = 1;
+static constexpr int32_t ring_state_error = 2;
+static constexpr int32_t ring_record_wrap = -1;
+static constexpr int32_t ring_record_oversized = -2;
+
+static inline uint32_t
+alignRecord(std::size_t size)
+{
+  return static_cast<uint32_t>((size + 3) & ~static_cast<std::size_t>(3));
+}
+
+RowRing::RowRing(Napi::Env env,
+                 Napi::Uint8Array memory,
+                 Napi::Function notifyJsFn,
+                 std::shared_ptr<couchbase::core::columnar::query_result> result,
+                 std::shared_ptr<QueryTrace> trace,
+                 std::shared_ptr<MemoryAccount> memory,
+                 std::shared_ptr<RowBudget> budget)
+  : _result(std::move(result))
+  , _trace(std::move(trace))
+  , _memory(std::move(memory))
+  , _budget(std::move(budget))
+{
+  auto capacity = memory.ByteLength() - header_size;
+  if (memory.ByteLength() <= header_size || (capacity & (capacity - 1)) != 0 ||
+      capacity > (1U << 30) || reinterpret_cast<uintptr_t>(memory.Data()) % sizeof(int32_t) != 0) {
+    throw Napi::RangeError::New(env, "Row ring size must be a power of two");
+  }
+
+  _memoryRef = Napi::Persistent(memory);
+  _data = memory.Data();
+  _capacity = static_cast<uint32_t>(capacity);
+  for (std::size_t i = 0; i < 4; ++i) {
+    slot(i).store(0);
+  }
+
+  // Only keeps the event loop alive while JS is actually waiting for rows.
+  _notify = Napi::ThreadSafeFunction::New(env, notifyJsFn, "cbQueryRowRing", 0, 1);
+  _notify.Unref(env);
+}
+
+RowRing::~RowRing()
+{
+  // the rows held natively are only accounted for while they are held
+  std::int64_t held = 0;
+  if (_pending.has_value()) {
+    held += static_cast<std::int64_t>(_pending->size());
+  }
+  for (const auto& row : _oversized) {
+    held += static_cast<std::int64_t>(row.content.size());
+  }
+  _memory->adjust(-held);
+}
+
+std::atomic<int32_t>&
+RowRing::slot(std::size_t index)
+{
+  return reinterpret_cast<std::atomic<int32_t>*>(_data)[index];
+}
+
+void
+RowRing::start()
+{
+  pump();
+}
+
+bool
+RowRing::wait(Napi::Env env)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (!_data || _finished || slot(0).load() != slot(1).load() || slot(2).load() != 0) {
+    return true;
+  }
+  _waiting = true;
+  _notify.Ref(env);
+  return false;
+}
+
+void
+RowRing::resume()
+{
+  // released outside of the lock, as the release may run parked pulls inline
+  std::optional<RowBudget::Reservation> released;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_pending.has_value()) {
+      return;
+    }
+    // an oversized row is moved out of _pending by the write
+    auto pendingSize = static_cast<std::int64_t>(_pending->size());
+    if (!writeLocked(_pending.value())) {
+      return;
+    }
+    _memory->adjust(-pendingSize);
+    _pending.reset();
+    if (_pendingReservation.has_value()) {
+      released.emplace(std::move(_pendingReservation.value()));
+      _pendingReservation.reset();
+    }
+    slot(3).store(0);
+  }
+  released.reset();
+  pump();
+}
+
+std::string
+RowRing::takeOversizedRow()
+{
+  // the reservation is released outside of the lock, once the row is returned
+  std::optional<held_row> row;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_oversized.empty()) {
+      return {};
+    }
+    row.emplace(std::move(_oversized.front()));
+    _oversized.pop_front();
+    _memory->adjust(-static_cast<std::int64_t>(row->content.size()));
+  }
+  return std::move(row->content);
+}
+
+std::optional<couchbase::core::columnar::error>
+RowRing::error()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _error;
+}
+
+void
+RowRing::detach()
+{
+  bool finished;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _data = nullptr;
+    finished = _finished;
+    if (!_finished) {
+      _finished = true;
+      _notify.Release();
+    }
+  }
+  _memoryRef.Reset();
+
+  if (!finished) {
+    _result->cancel();
+  }
+}
+
+void
+RowRing::pump()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_pumping) {
+      // the row callback ran inline, let the outer loop issue the next pull
+      _repump = true;
+      return;
+    }
+    _pumping = true;
+  }
+
+  auto self = shared_from_this();
+  while (true) {
+    auto pull = [self]() {
+      self->_result->next_row(
+        [self](result_variant resp, couchbase::core::columnar::error err) mutable {
+          self->onRow(std::move(resp), std::move(err));
+        });
+    };
+    if (_budget) {
+      _budget->schedule(std::move(pull));
+    } else {
+      pull();
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_repump) {
+      _pumping = false;
+      return;
+    }
+    _repump = false;
+  }
+}
+
+void
+RowRing::onRow(result_variant resp, couchbase::core::columnar::error err)
+{
+  _trace->onNextRow(resp, err, *_result);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_finished) {
+      return;
+    }
+
+    if (auto row = std::get_if<couchbase::core::columnar::query_result_row>(&resp); row) {
+      if (!writeLocked(row->content)) {
+        // Park the row until JS has made room.  JS checks the blocked flag after
+        // advancing the head, so check for space once more after raising it.
+        auto pendingSize = static_cast<std::int64_t>(row->content.size());
+        _pending = std::move(row->content);
+        _memory->adjust(pendingSize);
+        slot(3).store(1);
+        if (!writeLocked(_pending.value())) {
+          _pendingReservation.emplace(_budget, _pending->size());
+          return;
+        }
+        _memory->adjust(-pendingSize);
+        _pending.reset();
+        slot(3).store(0);
+      }
+      notifyLocked();
+    } else if (std::holds_alternative<couchbase::core::columnar::query_result_end>(resp)) {
+      finishLocked(ring_state_end);
+      return;
+    } else {
+      _error = std::move(err);
+      finishLocked(ring_state_error);
+      return;
+    }
+  }
+  pump();
+}
+
+bool
+RowRing::writeLocked(std::string& row)
+{
+  if (!_data) {
+    return true;
+  }
+
+  auto head = static_cast<uint32_t>(slot(0).load());
+  auto tail = static_cast<uint32_t>(slot(1).load(std::memory_order_relaxed));
+  uint32_t available = _capacity - (tail - head);
+  bool oversized = row.size() + sizeof(int32_t) > _capacity;
+  uint32_t needed = sizeof(int32_t) + (oversized ? 0 : alignRecord(row.size()));
+  uint32_t index = tail & (_capacity - 1);
+  uint32_t contiguous = _capacity - index;
+  auto records = _data + header_size;
+
+  if (needed > contiguous) {
+    if (available < contiguous) {
+      return false;
+    }
+    // Publish the wrap on its own, a row which does not fit next to it yet
+    // only fits once JS has read past the marker.
+    std::memcpy(records + index, &ring_record_wrap, sizeof(int32_t));
+    tail += contiguous;
+    available -= contiguous;
+    index = 0;
+    slot(1).store(static_cast<int32_t>(tail));
+    if (needed > available) {
+      notifyLocked();
+      return false;
+    }
+  } else if (needed > available) {
+    return false;
+  }
+
+  if (oversized) {
+    std::memcpy(records + index, &ring_record_oversized, sizeof(int32_t));
+    auto size = row.size();
+    _memory->adjust(static_cast<std::int64_t>(size));
+    _oversized.push_back(held_row{ std::move(row), RowBudget::Reservation(_budget, size) });
+  } else {
+    auto length = static_cast<int32_t>(row.size());
+    std::memcpy(records + index, &length, sizeof(int32_t));
+    std::memcpy(records + index + sizeof(int32_t), row.data(), row.size());
+  }
+  slot(1).store(static_cast<int32_t>(tail + needed));
+  return true;
+}
+
+void
+RowRing::finishLocked(int32_t state)
+{
+  if (_data) {
+    slot(2).store(state);
+  }
+  _finished = true;
+  notifyLocked();
+  _notify.Release();
+}
+
+void
+RowRing::notifyLocked()
+{
+  if (!_waiting) {
+    return;
+  }
+  _waiting = false;
+  _notify.NonBlockingCall([self = shared_from_this()](Napi::Env env, Napi::Function callback) {
+    self->_notify.Unref(env);
+    callback.Call({});
+  });
+}
+
+} // namespace couchnode
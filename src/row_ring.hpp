@@ -0,0 +1,121 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include "memory_account.hpp"
+#include "query_trace.hpp"
+#include "row_budget.hpp"
+#include <atomic>
+#include <core/columnar/error.hxx>
+#include <core/columnar/query_result.hxx>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <napi.h>
+#include <optional>
+#include <string>
+
+namespace couchnode
+{
+
+// Single producer, single consumer ring of rows living in memory shared with
+// JS (a SharedArrayBuffer).  The IO thread pulls rows from the query result
+// and writes them as length-prefixed records, JS reads them directly using
+// Atomics on the head/tail indices and is only woken up through the event
+// loop when it has found the ring empty and asked to be notified.
+//
+// Layout: four int32 header slots followed by a power of two sized data area.
+//   [0] head - read position, advanced by JS
+//   [1] tail - write position, advanced by the IO thread
+//   [2] state - 0 while streaming, 1 once all rows were written, 2 on error
+//   [3] blocked - set while the IO thread is waiting for free space
+// Positions are free running and wrap at 2^32.  Records are 4-byte aligned,
+// start with an int32 length and never straddle the end of the data area.  A
+// length of -1 marks the rest of the data area as unused, -2 marks a row which
+// was larger than the whole ring and is held natively instead.  Rows count
+// against the row budget only while they are held natively, that is while
+// parked waiting for space or held as oversized rows.
+class RowRing : public std::enable_shared_from_this<RowRing>
+{
+public:
+  static constexpr std::size_t header_size = 4 * sizeof(int32_t);
+
+  RowRing(Napi::Env env,
+          Napi::Uint8Array memory,
+          Napi::Function notifyJsFn,
+          std::shared_ptr<couchbase::core::columnar::query_result> result,
+          std::shared_ptr<QueryTrace> trace,
+          std::shared_ptr<MemoryAccount> memory,
+          std::shared_ptr<RowBudget> budget);
+  ~RowRing();
+
+  // Starts pulling rows into the ring on the IO thread.
+  void start();
+
+  // Called by JS after finding the ring empty.  Returns true if there is
+  // something to read after all, otherwise JS will be notified once there is.
+  bool wait(Napi::Env env);
+
+  // Called by JS after it has freed space while the writer was blocked.
+  void resume();
+
+  std::string takeOversizedRow();
+  std::optional<couchbase::core::columnar::error> error();
+
+  // Stops any further writes into the shared memory, must be called before
+  // JS can release it.
+  void detach();
+
+private:
+  using result_variant = std::variant<std::monostate,
+                                      couchbase::core::columnar::query_result_row,
+                                      couchbase::core::columnar::query_result_end>;
+
+  struct held_row {
+    std::string content;
+    RowBudget::Reservation reservation;
+  };
+
+  std::atomic<int32_t>& slot(std::size_t index);
+  void pump();
+  void onRow(result_variant resp, couchbase::core::columnar::error err);
+  bool writeLocked(std::string& row);
+  void finishLocked(int32_t state);
+  void notifyLocked();
+
+  std::shared_ptr<couchbase::core::columnar::query_result> _result;
+  std::shared_ptr<QueryTrace> _trace;
+  std::shared_ptr<MemoryAccount> _memory;
+  std::shared_ptr<RowBudget> _budget;
+  Napi::Reference<Napi::Uint8Array> _memoryRef;
+  Napi::ThreadSafeFunction _notify;
+
+  std::mutex _mutex;
+  uint8_t* _data{ nullptr };
+  uint32_t _capacity{ 0 };
+  std::optional<std::string> _pending;
+  std::optional<RowBudget::Reservation> _pendingReservation;
+  std::deque<held_row> _oversized;
+  std::optional<couchbase::core::columnar::error> _error;
+  bool _waiting{ false };
+  bool _pumping{ false };
+  bool _repump{ false };
+  bool _finished{ false };
+};
+
+} // namespace couchnode
@@ -0,0 +1,488 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "row_schema.hpp"
+#include "js_strings.hpp"
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <tao/json.hpp>
+
+namespace couchnode
+{
+
+namespace
+{
+// A minimal JSON scanner for the top level object of a row.  Nested values of
+// `any` fields are only skipped over here, they are validated by JSON.parse.
+class RowScanner
+{
+public:
+  explicit RowScanner(const std::string& row)
+    : _p(row.data())
+    , _end(row.data() + row.size())
+  {
+  }
+
+  void skipWhitespace()
+  {
+    while (_p != _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r')) {
+      ++_p;
+    }
+  }
+
+  bool atEnd() const
+  {
+    return _p == _end;
+  }
+
+  char peek() const
+  {
+    return _p != _end ? *_p : '\0';
+  }
+
+  bool consume(char c)
+  {
+    if (_p != _end && *_p == c) {
+      ++_p;
+      return true;
+    }
+    return false;
+  }
+
+  bool consumeLiteral(const char* literal)
+  {
+    auto length = std::strlen(literal);
+    if (static_cast<std::size_t>(_end - _p) < length || std::memcmp(_p, literal, length) != 0) {
+      return false;
+    }
+    _p += length;
+    return true;
+  }
+
+  bool readString(std::string& out)
+  {
+    if (!consume('"')) {
+      return false;
+    }
+    out.clear();
+    auto start = _p;
+    while (_p != _end && *_p != '"' && *_p != '\\') {
+      if (static_cast<unsigned char>(*_p) < 0x20) {
+        return false;
+      }
+      ++_p;
+    }
+    out.append(start, _p);
+    while (_p != _end && *_p != '"') {
+      if (*_p == '\\') {
+        ++_p;
+        if (!readEscape(out)) {
+          return false;
+        }
+      } else if (static_cast<unsigned char>(*_p) < 0x20) {
+        return false;
+      } else {
+        out += *_p++;
+      }
+    }
+    return consume('"');
+  }
+
+  bool readNumber(double& out)
+  {
+    auto start = _p;
+    consume('-');
+    if (_p == _end || *_p < '0' || *_p > '9') {
+      return false;
+    }
+    while (_p != _end && ((*_p >= '0' && *_p <= '9') || *_p == '.' || *_p == 'e' ||
+                          *_p == 'E' || *_p == '+' || *_p == '-')) {
+      ++_p;
+    }
+    // strtod would honour the process locale's decimal separator, both of these
+    // parse JSON's '.' regardless and must consume exactly the scanned characters
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    auto [parsedEnd, ec] = std::from_chars(start, _p, out);
+    return ec == std::errc() && parsedEnd == _p;
+#else
+    try {
+      out = tao::json::from_string(std::string_view(start, _p - start)).as<double>();
+      return true;
+    } catch (const std::exception&) {
+      return false;
+    }
+#endif
+  }
+
+  bool skipValue()
+  {
+    auto c = peek();
+    if (c == '"') {
+      std::string ignored;
+      return readString(ignored);
+    }
+    if (c == '{' || c == '[') {
+      std::size_t depth = 0;
+      while (_p != _end) {
+        c = *_p;
+        if (c == '"') {
+          if (!skipString()) {
+            return false;
+          }
+          continue;
+        }
+        ++_p;
+        if (c == '{' || c == '[') {
+          ++depth;
+        } else if (c == '}' || c == ']') {
+          if (--depth == 0) {
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+    auto start = _p;
+    while (_p != _end && *_p != ',' && *_p != '}' && *_p != ']' && *_p != ' ' && *_p != '\t' &&
+           *_p != '\n' && *_p != '\r') {
+      ++_p;
+    }
+    return _p != start;
+  }
+
+  const char* position() const
+  {
+    return _p;
+  }
+
+private:
+  bool skipString()
+  {
+    ++_p;
+    while (_p != _end && *_p != '"') {
+      if (*_p == '\\' && ++_p == _end) {
+        return false;
+      }
+      ++_p;
+    }
+    return consume('"');
+  }
+
+  bool readHex4(std::uint32_t& out)
+  {
+    if (_end - _p < 4) {
+      return false;
+    }
+    out = 0;
+    for (int i = 0; i < 4; ++i) {
+      auto c = *_p++;
+      out <<= 4;
+      if (c >= '0' && c <= '9') {
+        out |= static_cast<std::uint32_t>(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        out |= static_cast<std::uint32_t>(c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        out |= static_cast<std::uint32_t>(c - 'A' + 10);
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool readEscape(std::string& out)
+  {
+    if (_p == _end) {
+      return false;
+    }
+    switch (*_p++) {
+      case '"':
+        out += '"';
+        return true;
+      case '\\':
+        out += '\\';
+        return true;
+      case '/':
+        out += '/';
+        return true;
+      case 'b':
+        out += '\b';
+        return true;
+      case 'f':
+        out += '\f';
+        return true;
+      case 'n':
+        out += '\n';
+        return true;
+      case 'r':
+        out += '\r';
+        return true;
+      case 't':
+        out += '\t';
+        return true;
+      case 'u':
+        break;
+      default:
+        return false;
+    }
+
+    std::uint32_t codepoint;
+    if (!readHex4(codepoint)) {
+      return false;
+    }
+    if (codepoint >= 0xd800 && codepoint <= 0xdbff) {
+      std::uint32_t low;
+      if (!consumeLiteral("\\u") || !readHex4(low) || low < 0xdc00 || low > 0xdfff) {
+        // lone surrogates can not be represented in UTF-8, leave them to JSON.parse
+        return false;
+      }
+      codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+    } else if (codepoint >= 0xdc00 && codepoint <= 0xdfff) {
+      return false;
+    }
+
+    if (codepoint < 0x80) {
+      out += static_cast<char>(codepoint);
+    } else if (codepoint < 0x800) {
+      out += static_cast<char>(0xc0 | (codepoint >> 6));
+      out += static_cast<char>(0x80 | (codepoint & 0x3f));
+    } else if (codepoint < 0x10000) {
+      out += static_cast<char>(0xe0 | (codepoint >> 12));
+      out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (codepoint & 0x3f));
+    } else {
+      out += static_cast<char>(0xf0 | (codepoint >> 18));
+      out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3f));
+      out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (codepoint & 0x3f));
+    }
+    return true;
+  }
+
+  const char* _p;
+  const char* _end;
+};
+} // namespace
+
+RowSchema
+RowSchema::fromJs(Napi::Value jsSchema)
+{
+  auto env = jsSchema.Env();
+  if (!jsSchema.IsArray()) {
+    throw Napi::TypeError::New(env, "Schema must be an array of fields");
+  }
+  auto jsFields = jsSchema.As<Napi::Array>();
+
+  std::vector<field> fields;
+  for (uint32_t i = 0; i < jsFields.Length(); ++i) {
+    auto jsFieldValue = jsFields.Get(i);
+    if (!jsFieldValue.IsObject()) {
+      throw Napi::TypeError::New(env, "Schema fields must be objects");
+    }
+    auto jsField = jsFieldValue.As<Napi::Object>();
+    field f;
+    f.name = jsField.Get("name").ToString().Utf8Value();
+    auto type = jsField.Get("type").ToString().Utf8Value();
+    if (type == "string") {
+      f.type = field_type::string;
+    } else if (type == "number") {
+      f.type = field_type::number;
+    } else if (type == "boolean") {
+      f.type = field_type::boolean;
+    } else if (type == "any") {
+      f.type = field_type::any;
+    } else {
+      throw Napi::TypeError::New(env, "Unknown schema field type '" + type + "'");
+    }
+    f.nullable = jsField.Get("nullable").ToBoolean().Value();
+    fields.emplace_back(std::move(f));
+  }
+
+  RowSchema schema(std::move(fields));
+  if (schema._index.size() != schema._fields.size()) {
+    throw Napi::TypeError::New(env, "Schema field names must be unique");
+  }
+  return schema;
+}
+
+RowSchema::RowSchema(std::vector<field> fields)
+  : _fields(std::move(fields))
+{
+  for (std::size_t i = 0; i < _fields.size(); ++i) {
+    _index.emplace(_fields[i].name, i);
+  }
+}
+
+ShapedRow
+RowSchema::decode(std::string&& row) const
+{
+  ShapedRow shaped;
+  shaped.matched = decodeRow(row, shaped.values);
+  if (!shaped.matched) {
+    shaped.values.clear();
+    shaped.raw = std::move(row);
+  }
+  return shaped;
+}
+
+bool
+RowSchema::decodeRow(const std::string& row, std::vector<ShapedValue>& values) const
+{
+  values.assign(_fields.size(), {});
+  std::vector<bool> seen(_fields.size(), false);
+  std::size_t seenCount = 0;
+
+  RowScanner scanner(row);
+  std::string key;
+  scanner.skipWhitespace();
+  if (!scanner.consume('{')) {
+    return false;
+  }
+  scanner.skipWhitespace();
+  if (!scanner.consume('}')) {
+    for (;;) {
+      scanner.skipWhitespace();
+      if (!scanner.readString(key)) {
+        return false;
+      }
+      auto it = _index.find(key);
+      if (it == _index.end() || seen[it->second]) {
+        // unknown and duplicate fields can not be represented by the template
+        return false;
+      }
+      const auto& f = _fields[it->second];
+      auto& value = values[it->second];
+      seen[it->second] = true;
+      ++seenCount;
+
+      scanner.skipWhitespace();
+      if (!scanner.consume(':')) {
+        return false;
+      }
+      scanner.skipWhitespace();
+
+      if (f.type != field_type::any && scanner.peek() == 'n') {
+        if (!f.nullable || !scanner.consumeLiteral("null")) {
+          return false;
+        }
+        value.kind = ShapedValue::value_kind::null;
+      } else {
+        switch (f.type) {
+          case field_type::string:
+            value.kind = ShapedValue::value_kind::string;
+            if (!scanner.readString(value.text)) {
+              return false;
+            }
+            break;
+          case field_type::number:
+            value.kind = ShapedValue::value_kind::number;
+            if (!scanner.readNumber(value.number)) {
+              return false;
+            }
+            break;
+          case field_type::boolean:
+            value.kind = ShapedValue::value_kind::boolean;
+            if (scanner.consumeLiteral("true")) {
+              value.boolean = true;
+            } else if (!scanner.consumeLiteral("false")) {
+              return false;
+            }
+            break;
+          case field_type::any: {
+            value.kind = ShapedValue::value_kind::json;
+            auto start = scanner.position();
+            if (!scanner.skipValue()) {
+              return false;
+            }
+            value.text.assign(start, scanner.position());
+            break;
+          }
+        }
+      }
+
+      scanner.skipWhitespace();
+      if (scanner.consume('}')) {
+        break;
+      }
+      if (!scanner.consume(',')) {
+        return false;
+      }
+    }
+  }
+  scanner.skipWhitespace();
+  return scanner.atEnd() && seenCount == _fields.size();
+}
+
+RowTemplate::RowTemplate(Napi::Env env, const RowSchema& schema)
+{
+  for (const auto& f : schema.fields()) {
+    _keys.emplace_back(Napi::Persistent(Napi::String::New(env, f.name)));
+  }
+  auto json = env.Global().Get("JSON").As<Napi::Object>();
+  _jsonParse = Napi::Persistent(json.Get("parse").As<Napi::Function>());
+}
+
+Napi::Value
+RowTemplate::toJs(Napi::Env env, ShapedRow&& row) const
+{
+  if (!row.matched) {
+    return utf8ToJs(env, std::move(row.raw));
+  }
+
+  // Defining every property in one call, always in the same order, results in
+  // the same chain of map transitions (and therefore hidden class) for every row.
+  std::vector<napi_property_descriptor> properties(_keys.size());
+  for (std::size_t i = 0; i < _keys.size(); ++i) {
+    auto& value = row.values[i];
+    napi_value jsValue;
+    switch (value.kind) {
+      case ShapedValue::value_kind::null:
+        jsValue = env.Null();
+        break;
+      case ShapedValue::value_kind::boolean:
+        jsValue = Napi::Boolean::New(env, value.boolean);
+        break;
+      case ShapedValue::value_kind::number:
+        jsValue = Napi::Number::New(env, value.number);
+        break;
+      case ShapedValue::value_kind::string:
+        jsValue = utf8ToJs(env, std::move(value.text));
+        break;
+      case ShapedValue::value_kind::json:
+        jsValue = _jsonParse.Call({ utf8ToJs(env, std::move(value.text)) });
+        break;
+    }
+    properties[i] = { nullptr,
+                      _keys[i].Value(),
+                      nullptr,
+                      nullptr,
+                      nullptr,
+                      jsValue,
+                      static_cast<napi_property_attributes>(napi_writable | napi_enumerable |
+                                                            napi_configurable),
+                      nullptr };
+  }
+
+  auto obj = Napi::Object::New(env);
+  if (napi_define_properties(env, obj, properties.size(), properties.data()) != napi_ok) {
+    throw Napi::Error::New(env);
+  }
+  return obj;
+}
+
+} // namespace couchnode
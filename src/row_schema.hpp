@@ -0,0 +1,93 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include <napi.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace couchnode
+{
+
+// A single top level field of a row decoded against a RowSchema.  Fields of the
+// `any` type keep their raw JSON, which is parsed on the JS thread.
+struct ShapedValue {
+  enum class value_kind { null, boolean, number, string, json };
+
+  value_kind kind{ value_kind::null };
+  bool boolean{ false };
+  double number{ 0 };
+  std::string text;
+};
+
+// A row decoded against a RowSchema on the IO thread.  Rows which do not match
+// the schema keep their raw JSON instead, to be handed to the deserializer.
+struct ShapedRow {
+  bool matched{ false };
+  std::vector<ShapedValue> values;
+  std::string raw;
+};
+
+// The expected shape of the rows of a query: an object with exactly the given
+// fields, in any order, with values of the given types.
+class RowSchema
+{
+public:
+  enum class field_type { string, number, boolean, any };
+
+  struct field {
+    std::string name;
+    field_type type{ field_type::any };
+    bool nullable{ false };
+  };
+
+  static RowSchema fromJs(Napi::Value jsSchema);
+
+  explicit RowSchema(std::vector<field> fields);
+
+  const std::vector<field>& fields() const
+  {
+    return _fields;
+  }
+
+  // Called on the IO thread, the raw row is only kept when it does not match.
+  ShapedRow decode(std::string&& row) const;
+
+private:
+  bool decodeRow(const std::string& row, std::vector<ShapedValue>& values) const;
+
+  std::vector<field> _fields;
+  std::unordered_map<std::string, std::size_t> _index;
+};
+
+// The JS side of a RowSchema, which must only be used on the JS thread.  Every
+// row object is built from the same property names in the same order, so that
+// all of them share a single hidden class.
+class RowTemplate
+{
+public:
+  RowTemplate(Napi::Env env, const RowSchema& schema);
+
+  Napi::Value toJs(Napi::Env env, ShapedRow&& row) const;
+
+private:
+  std::vector<Napi::Reference<Napi::String>> _keys;
+  Napi::FunctionReference _jsonParse;
+};
+
+} // namespace couchnode
@@ -0,0 +1,432 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "row_spill.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace couchnode
+{
+
+// Rows are written in batches of this size and read back in chunks of
+// spill_read_size.  Pulling rows pauses while spill_max_pending bytes are
+// waiting for the disk.
+static constexpr std::size_t spill_flush_size = 256 * 1024;
+static constexpr std::size_t spill_max_pending = 4 * spill_flush_size;
+static constexpr std::size_t spill_read_size = 1024 * 1024;
+
+static inline void
+closeFd(int fd)
+{
+#ifdef _WIN32
+  _close(fd);
+#else
+  ::close(fd);
+#endif
+}
+
+// Creates the spill file so that only the current user can read it, and
+// opens it once for writing and once for reading.  The file is already gone
+// from the directory once both are open (or is deleted along with the last
+// handle on Windows), so nothing is left behind even if the process dies.
+static bool
+openSpillFile(const std::string& path, std::FILE*& writer, std::FILE*& reader)
+{
+#ifdef _WIN32
+  auto wideLength = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+  std::wstring widePath(static_cast<std::size_t>(std::max(wideLength, 1)), L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, widePath.data(), wideLength);
+  int writeFd = -1;
+  if (_wsopen_s(&writeFd,
+                widePath.c_str(),
+                _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY | _O_TEMPORARY | _O_NOINHERIT,
+                _SH_DENYWR,
+                _S_IREAD | _S_IWRITE) != 0) {
+    return false;
+  }
+  int readFd = -1;
+  if (_wsopen_s(&readFd,
+                widePath.c_str(),
+                _O_RDONLY | _O_BINARY | _O_TEMPORARY | _O_NOINHERIT,
+                _SH_DENYNO,
+                0) != 0) {
+    closeFd(writeFd);
+    return false;
+  }
+  writer = _fdopen(writeFd, "wb");
+  reader = _fdopen(readFd, "rb");
+#else
+  int writeFd = ::open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0600);
+  if (writeFd < 0) {
+    return false;
+  }
+  int readFd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  ::unlink(path.c_str());
+  if (readFd < 0) {
+    closeFd(writeFd);
+    return false;
+  }
+  writer = ::fdopen(writeFd, "wb");
+  reader = ::fdopen(readFd, "rb");
+#endif
+  if (writer == nullptr || reader == nullptr) {
+    if (writer != nullptr) {
+      std::fclose(writer);
+    } else {
+      closeFd(writeFd);
+    }
+    if (reader != nullptr) {
+      std::fclose(reader);
+    } else {
+      closeFd(readFd);
+    }
+    writer = nullptr;
+    reader = nullptr;
+    return false;
+  }
+  return true;
+}
+
+RowSpill::RowSpill(Napi::Env env,
+                   std::string path,
+                   Napi::Function notifyJsFn,
+                   std::shared_ptr<couchbase::core::columnar::query_result> result,
+                   std::shared_ptr<QueryTrace> trace,
+                   std::shared_ptr<MemoryAccount> memory,
+                   std::shared_ptr<RowBudget> budget)
+  : _path(std::move(path))
+  , _result(std::move(result))
+  , _trace(std::move(trace))
+  , _memory(std::move(memory))
+  , _budget(std::move(budget))
+{
+  if (!openSpillFile(_path, _writer, _reader)) {
+    throw Napi::Error::New(env, "Failed to create the spill file " + _path);
+  }
+  // records are batched in _pending, and read in large chunks into _readBuffer
+  std::setvbuf(_writer, nullptr, _IONBF, 0);
+  std::setvbuf(_reader, nullptr, _IONBF, 0);
+
+  // Only keeps the event loop alive while JS is actually waiting for rows.
+  _notify = Napi::ThreadSafeFunction::New(env, notifyJsFn, "cbQueryRowSpill", 0, 1);
+  _notify.Unref(env);
+}
+
+RowSpill::~RowSpill()
+{
+  close();
+  // only the batches on their way to and from the file are held in memory
+  _memory->adjust(-static_cast<std::int64_t>(_pending.size() + _readAhead.size() +
+                                             _readBuffer.size()));
+}
+
+void
+RowSpill::start()
+{
+  // The thread keeps the spill alive until close() stops it.
+  _worker = std::thread([self = shared_from_this()]() {
+    self->work();
+  });
+  pump();
+}
+
+std::vector<std::string>
+RowSpill::read(std::size_t maxRows)
+{
+  std::vector<std::string> rows;
+  while (rows.size() < maxRows) {
+    auto available = _readBuffer.size() - _readPos;
+    if (available >= sizeof(std::uint32_t)) {
+      std::uint32_t length;
+      std::memcpy(&length, _readBuffer.data() + _readPos, sizeof(length));
+      if (available >= sizeof(length) + length) {
+        rows.emplace_back(_readBuffer, _readPos + sizeof(length), length);
+        _readPos += sizeof(length) + length;
+        continue;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_closed || _readAhead.empty()) {
+      break;
+    }
+    _readBuffer.erase(0, _readPos);
+    _memory->adjust(-static_cast<std::int64_t>(_readPos));
+    _readPos = 0;
+    _readBuffer += _readAhead;
+    _readAhead.clear();
+    // let the file thread fetch the next chunk while these rows are consumed
+    _wake.notify_one();
+  }
+  return rows;
+}
+
+bool
+RowSpill::wait(Napi::Env env)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (!_readAhead.empty() || drainedLocked()) {
+    return true;
+  }
+  // also makes the file thread write out whatever has been collected so far
+  _waiting = true;
+  _notify.Ref(env);
+  _wake.notify_one();
+  return false;
+}
+
+bool
+RowSpill::done()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _closed || (drainedLocked() && _readPos == _readBuffer.size());
+}
+
+std::optional<couchbase::core::columnar::error>
+RowSpill::error()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _error;
+}
+
+std::optional<std::string>
+RowSpill::writeError()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _writeError;
+}
+
+void
+RowSpill::close()
+{
+  bool finished;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_closed) {
+      return;
+    }
+    _closed = true;
+    finished = _finished;
+    _finished = true;
+  }
+  _wake.notify_all();
+
+  if (_worker.joinable()) {
+    if (_worker.get_id() == std::this_thread::get_id()) {
+      _worker.detach();
+    } else {
+      _worker.join();
+    }
+  }
+  std::fclose(_writer);
+  _writer = nullptr;
+  std::fclose(_reader);
+  _reader = nullptr;
+  _notify.Release();
+
+  if (!finished) {
+    _result->cancel();
+  }
+}
+
+void
+RowSpill::pump()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_pumping) {
+      // the row callback ran inline, let the outer loop issue the next pull
+      _repump = true;
+      return;
+    }
+    _pumping = true;
+  }
+
+  auto self = shared_from_this();
+  while (true) {
+    auto pull = [self]() {
+      self->_result->next_row(
+        [self](result_variant resp, couchbase::core::columnar::error err) mutable {
+          self->onRow(std::move(resp), std::move(err));
+        });
+    };
+    if (_budget) {
+      _budget->schedule(std::move(pull));
+    } else {
+      pull();
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_repump) {
+      _pumping = false;
+      return;
+    }
+    _repump = false;
+  }
+}
+
+void
+RowSpill::onRow(result_variant resp, couchbase::core::columnar::error err)
+{
+  _trace->onNextRow(resp, err, *_result);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_finished) {
+      return;
+    }
+
+    if (auto row = std::get_if<couchbase::core::columnar::query_result_row>(&resp); row) {
+      auto length = static_cast<std::uint32_t>(row->content.size());
+      _pending.append(reinterpret_cast<const char*>(&length), sizeof(length));
+      _pending.append(row->content);
+      _memory->adjust(static_cast<std::int64_t>(sizeof(length) + row->content.size()));
+      if (_pending.size() >= spill_max_pending) {
+        // the disk is slower than the network, pull again once it caught up
+        _paused = true;
+      }
+      if (flushDueLocked()) {
+        _wake.notify_one();
+      }
+      if (_paused) {
+        return;
+      }
+    } else if (std::holds_alternative<couchbase::core::columnar::query_result_end>(resp)) {
+      finishLocked();
+      return;
+    } else {
+      _error = std::move(err);
+      finishLocked();
+      return;
+    }
+  }
+  pump();
+}
+
+void
+RowSpill::work()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (!_closed) {
+    if (flushDueLocked()) {
+      auto batch = std::move(_pending);
+      _pending.clear();
+      _flushing = true;
+      auto resume = std::exchange(_paused, false);
+      lock.unlock();
+
+      if (resume) {
+        pump();
+      }
+      auto written = std::fwrite(batch.data(), 1, batch.size(), _writer) == batch.size();
+      _memory->adjust(-static_cast<std::int64_t>(batch.size()));
+
+      lock.lock();
+      _flushing = false;
+      if (written) {
+        _committed += batch.size();
+        continue;
+      }
+      _writeError = "Failed to write to the spill file " + _path;
+      _memory->adjust(-static_cast<std::int64_t>(_pending.size()));
+      _pending.clear();
+      auto cancel = !_finished;
+      finishLocked();
+      if (cancel) {
+        lock.unlock();
+        _result->cancel();
+        lock.lock();
+      }
+      continue;
+    }
+
+    if (_readAhead.empty() && _fetched < _committed) {
+      auto chunk =
+        static_cast<std::size_t>(std::min<std::uint64_t>(_committed - _fetched, spill_read_size));
+      lock.unlock();
+
+      std::string buffer(chunk, '\0');
+      buffer.resize(std::fread(buffer.data(), 1, chunk, _reader));
+      _memory->adjust(static_cast<std::int64_t>(buffer.size()));
+
+      lock.lock();
+      _fetched += buffer.size();
+      _readAhead = std::move(buffer);
+      if (_readAhead.empty()) {
+        _writeError = "Failed to read from the spill file " + _path;
+        _fetched = _committed;
+        finishLocked();
+      }
+      notifyLocked();
+      continue;
+    }
+
+    if (drainedLocked()) {
+      notifyLocked();
+    }
+    _wake.wait(lock);
+  }
+}
+
+bool
+RowSpill::flushDueLocked() const
+{
+  // Rows are written in batches, or right away while JS is waiting for them.
+  return !_pending.empty() && !_writeError.has_value() &&
+         (_pending.size() >= spill_flush_size || _waiting || _finished || _paused);
+}
+
+bool
+RowSpill::drainedLocked() const
+{
+  // everything has been written to the file and handed back to JS
+  return _finished && _pending.empty() && !_flushing && _fetched == _committed &&
+         _readAhead.empty();
+}
+
+void
+RowSpill::finishLocked()
+{
+  _finished = true;
+  _wake.notify_one();
+}
+
+void
+RowSpill::notifyLocked()
+{
+  if (!_waiting) {
+    return;
+  }
+  _waiting = false;
+  _notify.NonBlockingCall([self = shared_from_this()](Napi::Env env, Napi::Function callback) {
+    self->_notify.Unref(env);
+    callback.Call({});
+  });
+}
+
+} // namespace couchnode
@@ -0,0 +1,128 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include "memory_account.hpp"
+#include "query_trace.hpp"
+#include "row_budget.hpp"
+#include <condition_variable>
+#include <core/columnar/error.hxx>
+#include <core/columnar/query_result.hxx>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <napi.h>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace couchnode
+{
+
+// Drains a query result into a temporary file as fast as the network delivers
+// it, so that the connection is released early no matter how slowly JS reads.
+// Rows are collected as length-prefixed records (a native uint32 length
+// followed by the row) and handed to a dedicated thread, which writes them to
+// the file in batches and reads them back a chunk ahead of JS.  Neither the IO
+// thread nor the event loop ever touch the disk, and JS is only woken up
+// through the event loop when it has caught up with the file.  The file is only
+// readable by the current user and is unlinked right after being opened, its
+// space is reclaimed once closed.  Pulls are scheduled through the row budget,
+// the rows on their way to the file are bounded by the pending write window
+// rather than held against it.
+class RowSpill : public std::enable_shared_from_this<RowSpill>
+{
+public:
+  RowSpill(Napi::Env env,
+           std::string path,
+           Napi::Function notifyJsFn,
+           std::shared_ptr<couchbase::core::columnar::query_result> result,
+           std::shared_ptr<QueryTrace> trace,
+           std::shared_ptr<MemoryAccount> memory,
+           std::shared_ptr<RowBudget> budget);
+  ~RowSpill();
+
+  // Starts the file thread and pulling rows on the IO thread.
+  void start();
+
+  // Returns up to maxRows of the rows which have been read back so far.
+  std::vector<std::string> read(std::size_t maxRows);
+
+  // Called by JS after read returned no rows.  Returns true if there is
+  // something to read after all (or the result is complete), otherwise JS will
+  // be notified once there is.
+  bool wait(Napi::Env env);
+
+  // Whether all rows have been written and read back.
+  bool done();
+
+  std::optional<couchbase::core::columnar::error> error();
+  std::optional<std::string> writeError();
+
+  // Stops writing, cancelling the query if it is still running, and releases
+  // the file.
+  void close();
+
+private:
+  using result_variant = std::variant<std::monostate,
+                                      couchbase::core::columnar::query_result_row,
+                                      couchbase::core::columnar::query_result_end>;
+
+  void pump();
+  void onRow(result_variant resp, couchbase::core::columnar::error err);
+  void work();
+  bool flushDueLocked() const;
+  bool drainedLocked() const;
+  void finishLocked();
+  void notifyLocked();
+
+  std::string _path;
+  std::shared_ptr<couchbase::core::columnar::query_result> _result;
+  std::shared_ptr<QueryTrace> _trace;
+  std::shared_ptr<MemoryAccount> _memory;
+  std::shared_ptr<RowBudget> _budget;
+  Napi::ThreadSafeFunction _notify;
+
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::thread _worker;
+  std::string _pending;
+  std::string _readAhead;
+  std::uint64_t _committed{ 0 };
+  std::uint64_t _fetched{ 0 };
+  std::optional<couchbase::core::columnar::error> _error;
+  std::optional<std::string> _writeError;
+  bool _flushing{ false };
+  bool _paused{ false };
+  bool _waiting{ false };
+  bool _pumping{ false };
+  bool _repump{ false };
+  bool _finished{ false };
+  bool _closed{ false };
+
+  // only used by the file thread
+  std::FILE* _writer{ nullptr };
+  std::FILE* _reader{ nullptr };
+
+  // only used on the JS thread
+  std::string _readBuffer;
+  std::size_t _readPos{ 0 };
+};
+
+} // namespace couchnode
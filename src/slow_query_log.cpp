@@ -0,0 +1,197 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "slow_query_log.hpp"
+#include <cerrno>
+#include <fstream>
+#include <random>
+#include <system_error>
+#include <tao/json.hpp>
+
+namespace couchnode
+{
+
+static double
+durationToMillis(std::chrono::microseconds duration)
+{
+  return static_cast<double>(duration.count()) / 1000.0;
+}
+
+static tao::json::value
+recordToJson(const SlowQueryRecord& record)
+{
+  tao::json::value obj = tao::json::empty_object;
+  obj["statement"] = record.statement;
+  obj["requestId"] = record.requestId;
+  obj["startedAt"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       record.startedAt.time_since_epoch())
+                       .count();
+  obj["duration"] = durationToMillis(record.duration);
+  if (record.serverElapsed.has_value()) {
+    obj["serverElapsed"] = durationToMillis(record.serverElapsed.value());
+  }
+  tao::json::value timings = tao::json::empty_object;
+  auto setPhase = [&timings](const char* name,
+                             const std::optional<std::chrono::microseconds>& offset) {
+    if (offset.has_value()) {
+      timings[name] = durationToMillis(offset.value());
+    }
+  };
+  setPhase("dispatched", record.timings.dispatched);
+  setPhase("firstByte", record.timings.firstByte);
+  setPhase("firstRow", record.timings.firstRow);
+  setPhase("lastRow", record.timings.lastRow);
+  setPhase("finished", record.timings.finished);
+  timings["jsQueued"] = durationToMillis(record.timings.jsQueued);
+  obj["timings"] = std::move(timings);
+  obj["rowCount"] = static_cast<std::uint64_t>(record.rowCount);
+  obj["bytes"] = static_cast<std::uint64_t>(record.bytes);
+  if (record.error.has_value()) {
+    obj["error"] = record.error.value();
+  }
+  obj["sampled"] = record.sampled;
+  return obj;
+}
+
+void
+SlowQueryLog::configure(options opts)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _options = std::move(opts);
+  while (_records.size() > _options.capacity) {
+    _records.pop_front();
+    _firstSequence++;
+    _overwritten++;
+  }
+}
+
+bool
+SlowQueryLog::enabled() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _options.capacity > 0 && (_options.threshold.has_value() || _options.sampleRate > 0);
+}
+
+bool
+SlowQueryLog::shouldRecord(std::chrono::microseconds duration,
+                           std::optional<std::chrono::microseconds> serverElapsed,
+                           bool& sampled)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_options.capacity == 0) {
+    return false;
+  }
+
+  if (_options.threshold.has_value()) {
+    auto threshold = _options.threshold.value();
+    if (duration >= threshold ||
+        serverElapsed.value_or(std::chrono::microseconds::zero()) >= threshold) {
+      sampled = false;
+      return true;
+    }
+  }
+
+  if (_options.sampleRate > 0) {
+    thread_local std::minstd_rand generator{ std::random_device{}() };
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    if (distribution(generator) < _options.sampleRate) {
+      sampled = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+SlowQueryLog::redacts() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _options.redact;
+}
+
+void
+SlowQueryLog::record(SlowQueryRecord&& record)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_options.capacity == 0) {
+    return;
+  }
+  if (_records.size() >= _options.capacity) {
+    _records.pop_front();
+    _firstSequence++;
+    _overwritten++;
+  }
+  _records.push_back(std::move(record));
+}
+
+std::vector<SlowQueryRecord>
+SlowQueryLog::drain()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::vector<SlowQueryRecord> records(std::make_move_iterator(_records.begin()),
+                                       std::make_move_iterator(_records.end()));
+  _firstSequence += _records.size();
+  _records.clear();
+  return records;
+}
+
+std::size_t
+SlowQueryLog::flush(const std::string& filename)
+{
+  std::ofstream out(filename, std::ios::out | std::ios::app);
+  if (!out) {
+    throw std::system_error(errno, std::generic_category(), "Failed to open " + filename);
+  }
+
+  // Records are only removed once they have been written, a failed write
+  // leaves all of them in the ring to be flushed again.
+  std::string lines;
+  std::size_t count;
+  std::uint64_t end;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto& record : _records) {
+      lines += tao::json::to_string(recordToJson(record));
+      lines += '\n';
+    }
+    count = _records.size();
+    end = _firstSequence + count;
+  }
+
+  out << lines;
+  out.flush();
+  if (!out) {
+    throw std::system_error(errno, std::generic_category(), "Failed to write " + filename);
+  }
+
+  // records written meanwhile are still there, others may have been overwritten
+  std::lock_guard<std::mutex> lock(_mutex);
+  while (!_records.empty() && _firstSequence < end) {
+    _records.pop_front();
+    _firstSequence++;
+  }
+  return count;
+}
+
+std::uint64_t
+SlowQueryLog::overwritten() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _overwritten;
+}
+
+} // namespace couchnode
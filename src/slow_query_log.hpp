@@ -0,0 +1,93 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include "query_timings.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace couchnode
+{
+
+struct SlowQueryRecord {
+  std::string statement;
+  std::string requestId;
+  std::chrono::system_clock::time_point startedAt;
+  std::chrono::microseconds duration;
+  std::optional<std::chrono::microseconds> serverElapsed;
+  QueryTimings timings;
+  std::size_t rowCount;
+  std::size_t bytes;
+  std::optional<std::string> error;
+  // set when the query was below the threshold and recorded by sampling
+  bool sampled;
+};
+
+// Bounded ring of the queries of a connection which exceeded the slow query
+// threshold, either as observed by the client or as reported by the server,
+// plus a random sample of the remaining queries.  The oldest records are
+// overwritten once the ring is full.
+class SlowQueryLog
+{
+public:
+  struct options {
+    std::optional<std::chrono::microseconds> threshold{};
+    double sampleRate{ 0 };
+    std::size_t capacity{ 128 };
+    bool redact{ false };
+  };
+
+  void configure(options opts);
+
+  // Whether any query can end up being recorded at all.
+  bool enabled() const;
+
+  // Whether statements are to be recorded normalized (see normalizeStatement),
+  // the records are expected to carry them that way already.
+  bool redacts() const;
+
+  // Decides whether a finished query is to be recorded, the statement and
+  // the rest of the record are only assembled when it is.
+  bool shouldRecord(std::chrono::microseconds duration,
+                    std::optional<std::chrono::microseconds> serverElapsed,
+                    bool& sampled);
+  void record(SlowQueryRecord&& record);
+
+  std::vector<SlowQueryRecord> drain();
+
+  // Appends the records to the file as JSON lines and removes them from the
+  // ring, returning how many were written.
+  std::size_t flush(const std::string& filename);
+
+  std::uint64_t overwritten() const;
+
+private:
+  mutable std::mutex _mutex;
+  options _options{};
+  std::deque<SlowQueryRecord> _records;
+  // the sequence number of the front record, counting every record ever added
+  std::uint64_t _firstSequence{ 0 };
+  std::uint64_t _overwritten{ 0 };
+};
+
+} // namespace couchnode
@@ -0,0 +1,174 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "statement.hpp"
+#include <algorithm>
+
+namespace couchnode
+{
+
+static inline bool
+isSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static inline bool
+isDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+static inline bool
+isIdentifierChar(char c)
+{
+  return isDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$' ||
+         static_cast<unsigned char>(c) >= 0x80;
+}
+
+// The whitespace of the original statement is dropped and tokens are spaced
+// out the same way no matter how they were written: separated by a single
+// space, except inside brackets, around member access and before separators.
+static inline bool
+needsSpace(std::string_view normalized, std::string_view next)
+{
+  if (normalized.empty()) {
+    return false;
+  }
+  auto last = normalized.back();
+  auto first = next.front();
+  if (last == '(' || last == '[' || last == '.' || first == ')' || first == ']' ||
+      first == ',' || first == '.' || first == ';') {
+    return false;
+  }
+  // function calls
+  return !(first == '(' && isIdentifierChar(last));
+}
+
+static inline bool
+isTwoCharOperator(std::string_view statement, std::size_t pos)
+{
+  if (pos + 1 >= statement.size()) {
+    return false;
+  }
+  auto op = statement.substr(pos, 2);
+  return op == "<=" || op == ">=" || op == "!=" || op == "<>" || op == "==" || op == "||";
+}
+
+// Skips a quoted literal or identifier starting at pos, returning the position
+// just past its closing quote.  Quotes are escaped either with a backslash or
+// by doubling them.
+static std::size_t
+skipQuoted(std::string_view statement, std::size_t pos)
+{
+  auto quote = statement[pos++];
+  while (pos < statement.size()) {
+    auto c = statement[pos++];
+    if (c == '\\') {
+      ++pos;
+    } else if (c == quote) {
+      if (pos < statement.size() && statement[pos] == quote) {
+        ++pos;
+        continue;
+      }
+      break;
+    }
+  }
+  return std::min(pos, statement.size());
+}
+
+std::string
+normalizeStatement(std::string_view statement)
+{
+  std::string normalized;
+  normalized.reserve(statement.size());
+
+  auto append = [&](std::string_view token) {
+    if (needsSpace(normalized, token)) {
+      normalized += ' ';
+    }
+    normalized += token;
+  };
+  // a literal following "?," continues a list of literals, which is kept as one
+  auto appendLiteral = [&]() {
+    auto size = normalized.size();
+    if (size >= 2 && normalized[size - 1] == ',' && normalized[size - 2] == '?') {
+      normalized.pop_back();
+      return;
+    }
+    append("?");
+  };
+
+  std::size_t pos = 0;
+  while (pos < statement.size()) {
+    auto c = statement[pos];
+
+    if (isSpace(c)) {
+      ++pos;
+    } else if (c == '-' && pos + 1 < statement.size() && statement[pos + 1] == '-') {
+      pos = statement.find('\n', pos);
+      if (pos == std::string_view::npos) {
+        pos = statement.size();
+      }
+    } else if (c == '/' && pos + 1 < statement.size() && statement[pos + 1] == '*') {
+      pos = statement.find("*/", pos + 2);
+      pos = pos == std::string_view::npos ? statement.size() : pos + 2;
+    } else if (c == '\'' || c == '"') {
+      pos = skipQuoted(statement, pos);
+      appendLiteral();
+    } else if (c == '`') {
+      auto end = skipQuoted(statement, pos);
+      append(statement.substr(pos, end - pos));
+      pos = end;
+    } else if (isDigit(c) ||
+               (c == '.' && pos + 1 < statement.size() && isDigit(statement[pos + 1]))) {
+      while (pos < statement.size() &&
+             (isIdentifierChar(statement[pos]) || statement[pos] == '.' ||
+              ((statement[pos] == '+' || statement[pos] == '-') &&
+               (statement[pos - 1] == 'e' || statement[pos - 1] == 'E')))) {
+        ++pos;
+      }
+      appendLiteral();
+    } else if (isIdentifierChar(c)) {
+      auto start = pos;
+      while (pos < statement.size() && isIdentifierChar(statement[pos])) {
+        ++pos;
+      }
+      append(statement.substr(start, pos - start));
+    } else if (isTwoCharOperator(statement, pos)) {
+      append(statement.substr(pos, 2));
+      pos += 2;
+    } else {
+      append(statement.substr(pos, 1));
+      ++pos;
+    }
+  }
+  return normalized;
+}
+
+std::uint64_t
+fingerprintStatement(std::string_view normalized)
+{
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (auto c : normalized) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+} // namespace couchnode
@@ -0,0 +1,38 @@
+/*
+ *  Copyright 2016-2024. Couchbase, Inc.
+ *  All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace couchnode
+{
+
+// Reduces a SQL++ statement to its shape: string and numeric literals are
+// replaced by '?' and comma separated runs of them (such as IN-lists) by a
+// single '?', comments are removed and the tokens are spaced out the same way
+// regardless of the original whitespace.  Identifiers (including escaped ones)
+// and parameter placeholders are kept as they are.
+std::string
+normalizeStatement(std::string_view statement);
+
+// Identifies the shape of a normalized statement (64-bit FNV-1a).
+std::uint64_t
+fingerprintStatement(std::string_view normalized);
+
+} // namespace couchnode
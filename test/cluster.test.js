@@ -18,8 +18,13 @@
 'use strict'
 
 const assert = require('chai').assert
+const fs = require('fs')
+const os = require('os')
+const path = require('path')
+const { Worker } = require('worker_threads')
 const H = require('./harness')
 
+const { BootstrapCache } = require('../lib/bootstrapcache')
 const { PassthroughDeserializer } = require('../lib/deserializers')
 
 describe('#Cluster', function () {
@@ -198,9 +203,355 @@ describe('#Cluster', function () {
     assert.instanceOf(cluster.deserializer, PassthroughDeserializer)
   })
 
-  it('should error ops after close and ignore superfluous closes', async function () {
-    this.skip() // TODO: Query after cluster.close() hangs
+  it('should share a connection between clusters', async function () {
+    H.skipIfIntegrationDisabled(this)
+    const options = { shareConnection: true }
+    const cluster1 = H.lib.Cluster.createInstance(
+      H.connStr,
+      H.credentials,
+      options
+    )
+    const cluster2 = H.lib.Cluster.createInstance(
+      H.connStr,
+      H.credentials,
+      options
+    )
+
+    await cluster1.executeQuery("SELECT 'Hello Earth!' AS message")
+    await cluster1.close()
+
+    // the shared connection stays open until the last cluster is closed
+    const res = await cluster2.executeQuery("SELECT 'Hello Mars!' AS message")
+    const rows = []
+    for await (const row of res.rows()) {
+      rows.push(row)
+    }
+    assert.equal(rows.length, 1)
+    await cluster2.close()
+  })
+
+  it('should share a connection with worker threads', async function () {
+    H.skipIfIntegrationDisabled(this)
+    const options = { shareConnection: true }
+    const cluster = H.lib.Cluster.createInstance(
+      H.connStr,
+      H.credentials,
+      options
+    )
+    await cluster.executeQuery("SELECT 'Hello Earth!' AS message")
+
+    const workerSource = `
+      const { parentPort, workerData } = require('worker_threads')
+      const columnar = require(workerData.libPath)
+      const cluster = columnar.Cluster.createInstance(
+        workerData.connStr,
+        workerData.credentials,
+        { shareConnection: true }
+      )
+      cluster
+        .executeQuery("SELECT 'Hello Mars!' AS message")
+        .then(async (res) => {
+          const rows = []
+          for await (const row of res.rows()) {
+            rows.push(row)
+          }
+          await cluster.close()
+          parentPort.postMessage(rows)
+        })
+    `
+    const runWorker = () =>
+      new Promise((resolve, reject) => {
+        const worker = new Worker(workerSource, {
+          eval: true,
+          workerData: {
+            libPath: require.resolve('../lib/columnar'),
+            connStr: H.connStr,
+            credentials: H.credentials,
+          },
+        })
+        worker.once('message', resolve)
+        worker.once('error', reject)
+      })
+
+    const results = await Promise.all([runWorker(), runWorker()])
+    for (const rows of results) {
+      assert.deepEqual(rows, [{ message: 'Hello Mars!' }])
+    }
+    await cluster.close()
+  })
+
+  it('should not share connections with different instance settings', async function () {
+    H.skipIfIntegrationDisabled(this)
+    const cluster1 = H.lib.Cluster.createInstance(H.connStr, H.credentials, {
+      shareConnection: true,
+      maxBufferedRowBytes: 1024 * 1024,
+    })
+    const cluster2 = H.lib.Cluster.createInstance(H.connStr, H.credentials, {
+      shareConnection: true,
+      maxBufferedRowBytes: 2 * 1024 * 1024,
+    })
+    await cluster1.executeQuery("SELECT 'Hello Earth!' AS message")
+    await cluster2.executeQuery("SELECT 'Hello Mars!' AS message")
+
+    assert.equal(cluster1.rowBufferUsage().limit, 1024 * 1024)
+    assert.equal(cluster2.rowBufferUsage().limit, 2 * 1024 * 1024)
+    await cluster1.close()
+    await cluster2.close()
+  })
+
+  it('should bulk upsert documents in bounded batches', async function () {
+    H.skipIfIntegrationDisabled(this)
+    const cluster = H.lib.Cluster.createInstance(H.connStr, H.credentials)
+
+    const marker = `bulk-${Date.now()}`
+    const docs = []
+    for (let i = 0; i < 50; ++i) {
+      docs.push({ id: `${marker}-${i}`, marker: marker, padding: 'x'.repeat(100) })
+    }
+    // pre-encoded documents are passed through as-is
+    docs.push(Buffer.from(JSON.stringify({ id: `${marker}-50`, marker: marker })))
+
+    const res = await cluster.bulkUpsert(
+      H.databaseName,
+      H.scopeName,
+      H.collectionName,
+      docs,
+      { batchBytes: 1024, concurrency: 2 }
+    )
+    assert.equal(res.succeeded, docs.length)
+    assert.equal(res.failed, 0)
+    assert.isAbove(res.batches.length, 1)
+    let expectedFirst = 0
+    for (const batch of res.batches) {
+      assert.equal(batch.firstDocument, expectedFirst)
+      assert.isNull(batch.error)
+      assert.isAtLeast(batch.attempts, 1)
+      expectedFirst += batch.documents
+    }
+    assert.equal(expectedFirst, docs.length)
+
+    const qres = await cluster.executeQuery(
+      `SELECT COUNT(*) AS cnt FROM ${H.fqdn} WHERE marker = $marker`,
+      { namedParameters: { marker: marker } }
+    )
+    const counts = []
+    for await (const row of qres.rows()) {
+      counts.push(row)
+    }
+    assert.deepEqual(counts, [{ cnt: docs.length }])
+
+    await H.throwsHelper(async () => {
+      await cluster.bulkUpsert(H.databaseName, H.scopeName, H.collectionName, docs, {
+        concurrency: 0,
+      })
+    }, H.lib.InvalidArgumentError)
+    // validation errors also reach the callback
+    const cbErr = await new Promise((resolve) => {
+      cluster
+        .bulkUpsert(
+          H.databaseName,
+          H.scopeName,
+          H.collectionName,
+          docs,
+          { maxRetries: -1 },
+          (err) => resolve(err)
+        )
+        .catch(() => {})
+    })
+    assert.instanceOf(cbErr, H.lib.InvalidArgumentError)
+
+    // pre-encoded documents cannot break out of the batch
+    await H.throwsHelper(async () => {
+      await cluster.bulkUpsert(H.databaseName, H.scopeName, H.collectionName, [
+        Buffer.from('{"id": "x"}]); DELETE FROM x; ([{}'),
+      ])
+    }, TypeError)
+    await cluster.close()
+  })
+
+  it('should warm up connections to every analytics node', async function () {
+    H.skipIfIntegrationDisabled(this)
+    const cluster = H.lib.Cluster.createInstance(H.connStr, H.credentials)
+
+    const res = await cluster.warmup({ connectionsPerNode: 2 })
+    assert.isArray(res.nodes)
+    assert.isAtLeast(res.nodes.length, 1)
+    for (const node of res.nodes) {
+      assert.isString(node.endpoint)
+      assert.equal(node.handshakeLatencies.length + node.errors.length, 2)
+    }
+
+    await H.throwsHelper(async () => {
+      await cluster.warmup({ connectionsPerNode: 0 })
+    }, H.lib.InvalidArgumentError)
+    await cluster.close()
+  })
+
+  it('should score analytics nodes by latency', async function () {
+    H.skipIfIntegrationDisabled(this)
+    const cluster = H.lib.Cluster.createInstance(H.connStr, H.credentials)
+
+    assert.isEmpty(cluster.nodeScores())
+    await cluster.warmup()
+    const scores = cluster.nodeScores()
+    assert.isAtLeast(scores.length, 1)
+    for (const node of scores) {
+      assert.isString(node.endpoint)
+      assert.isAtLeast(node.samples, 1)
+      assert.isAtMost(node.latencySamples, node.samples)
+      assert.isAtLeast(node.latencyEwma, 0)
+      if (node.latencySamples === 0) {
+        assert.equal(node.score, Infinity)
+      } else {
+        assert.isAtLeast(node.score, node.latencyEwma)
+      }
+    }
+    await cluster.close()
+  })
 
+  it('should bound the buffered row bytes', async function () {
+    H.skipIfIntegrationDisabled(this)
+    const cluster = H.lib.Cluster.createInstance(H.connStr, H.credentials, {
+      maxBufferedRowBytes: 1,
+    })
+
+    // with a single byte budget the streams have to take turns
+    const qs = `FROM RANGE(1, 100) AS i SELECT *`
+    const results = await Promise.all(
+      [1, 2, 3].map(async () => {
+        const res = await cluster.executeQuery(qs)
+        const rows = []
+        for await (const row of res.rows()) {
+          rows.push(row)
+        }
+        return rows
+      })
+    )
+    for (const rows of results) {
+      assert.equal(rows.length, 100)
+    }
+
+    const usage = cluster.rowBufferUsage()
+    assert.equal(usage.bufferedBytes, 0)
+    assert.equal(usage.limit, 1)
+    assert.equal(usage.pausedStreams, 0)
+    await cluster.close()
+  })
+
+  it('should account for native row memory', async function () {
+    H.skipIfIntegrationDisabled(this)
+    const cluster = H.lib.Cluster.createInstance(H.connStr, H.credentials)
+
+    // the ring holds rows larger than itself natively until they are read
+    const qs = `FROM RANGE(1, 10) AS i SELECT REPEAT("x", 8192) AS padding`
+    const res = await cluster.executeQuery(qs, { rowRingBufferSize: 4096 })
+    await new Promise((resolve) => setTimeout(resolve, 100))
+    assert.isAbove(res.nativeMemoryUsage(), 0)
+    let usage = cluster.nativeMemoryUsage()
+    assert.isAtLeast(usage.bytes, res.nativeMemoryUsage())
+    assert.isAtLeast(usage.results, 1)
+
+    let count = 0
+    for await (const row of res.rows()) {
+      assert.equal(row.padding.length, 8192)
+      count++
+    }
+    assert.equal(count, 10)
+    assert.equal(res.nativeMemoryUsage(), 0)
+    await cluster.close()
+  })
+
+  it('should record slow queries', async function () {
+    H.skipIfIntegrationDisabled(this)
+    const cluster = H.lib.Cluster.createInstance(H.connStr, H.credentials, {
+      slowQueryThreshold: 0,
+      redactSlowQueries: true,
+    })
+
+    const res = await cluster.executeQuery(
+      "SELECT 'Hello World!' AS message, 42 AS answer"
+    )
+    for await (const row of res.rows()) {
+      assert.isObject(row)
+    }
+
+    const slow = cluster.slowQueries()
+    assert.lengthOf(slow.records, 1)
+    const record = slow.records[0]
+    assert.equal(record.statement, 'SELECT ? AS message, ? AS answer')
+    assert.isNotEmpty(record.requestId)
+    assert.equal(record.rowCount, 1)
+    assert.isAbove(record.bytes, 0)
+    assert.isAtLeast(record.duration, record.timings.firstRow)
+    assert.isFalse(record.sampled)
+    assert.lengthOf(cluster.slowQueries().records, 0)
+
+    const filename = path.join(os.tmpdir(), `columnar-slow-${process.pid}.log`)
+    try {
+      const res = await cluster.executeQuery("SELECT 'Hello Mars!' AS message")
+      for await (const row of res.rows()) {
+        assert.isObject(row)
+      }
+      assert.equal(cluster.flushSlowQueries(filename), 1)
+      const lines = fs.readFileSync(filename, 'utf8').trim().split('\n')
+      assert.lengthOf(lines, 1)
+      assert.equal(JSON.parse(lines[0]).statement, 'SELECT ? AS message')
+    } finally {
+      fs.rmSync(filename, { force: true })
+    }
+    await cluster.close()
+  })
+
+  it('should aggregate query stats by statement shape', async function () {
+    H.skipIfIntegrationDisabled(this)
+    const cluster = H.lib.Cluster.createInstance(H.connStr, H.credentials, {
+      maxQueryFingerprints: 100,
+    })
+
+    // whitespace and the number of literals in a list do not change the shape
+    for (const statement of [
+      'SELECT 1  AS value',
+      'SELECT 2 AS value',
+      'SELECT\n3 AS value',
+    ]) {
+      const res = await cluster.executeQuery(statement)
+      for await (const row of res.rows()) {
+        assert.isObject(row)
+      }
+    }
+
+    const stats = cluster.queryStats()
+    const shape = stats.statements.find(
+      (s) => s.statement === 'SELECT ? AS value'
+    )
+    assert.isDefined(shape)
+    assert.equal(shape.calls, 3)
+    assert.equal(shape.errors, 0)
+    assert.equal(shape.rows, 3)
+    assert.isAtLeast(shape.p99Time, shape.meanTime * 0.8)
+
+    for (const list of ['1', '1, 2', '1,2,3']) {
+      const res = await cluster.executeQuery(
+        `FROM [1, 2, 3] AS v WHERE v IN [${list}] SELECT VALUE v`
+      )
+      for await (const row of res.rows()) {
+        assert.isNumber(row)
+      }
+    }
+    const listShape = cluster
+      .queryStats()
+      .statements.find(
+        (s) => s.statement === 'FROM [?] AS v WHERE v IN [?] SELECT VALUE v'
+      )
+    assert.isDefined(listShape)
+    assert.equal(listShape.calls, 3)
+
+    cluster.resetQueryStats()
+    assert.lengthOf(cluster.queryStats().statements, 0)
+    await cluster.close()
+  })
+
+  it('should error ops after close and ignore superfluous closes', async function () {
     H.skipIfIntegrationDisabled()
     const cluster = H.lib.Cluster.createInstance(H.connStr, H.credentials)
     const scope = cluster.database(H.databaseName).scope(H.scopeName)
@@ -220,3 +571,104 @@ describe('#Cluster', function () {
     await cluster.close()
   })
 })
+
+describe('#logging', function () {
+  it('should reject invalid log levels', function () {
+    assert.throws(() => {
+      H.lib.setLogLevel('chatty')
+    }, Error)
+  })
+
+  it('should log asynchronously and count queued messages', async function () {
+    H.skipIfIntegrationDisabled(this)
+    const filename = path.join(os.tmpdir(), `columnar-log-${process.pid}.log`)
+    H.lib.enableAsyncLogging({
+      filename: filename,
+      level: H.lib.LogLevel.Debug,
+      dropPolicy: H.lib.LogDropPolicy.DropOldest,
+    })
+
+    try {
+      const cluster = H.lib.Cluster.createInstance(H.connStr, H.credentials)
+      await cluster.executeQuery("SELECT 'Hello World!' AS message")
+      await cluster.close()
+
+      const stats = H.lib.logStats()
+      assert.isObject(stats.logger)
+      assert.isAbove(stats.logger.enqueued, 0)
+      assert.isAtLeast(stats.logger.queueSize, 8192)
+      assert.isAtMost(stats.logger.written, stats.logger.enqueued)
+    } finally {
+      H.lib.setLogLevel(H.lib.LogLevel.Off)
+      fs.rmSync(filename, { force: true })
+    }
+  })
+})
+
+describe('#BootstrapCache', function () {
+  const filename = path.join(os.tmpdir(), `columnar-boot-${process.pid}.json`)
+
+  afterEach(function () {
+    fs.rmSync(filename, { force: true })
+  })
+
+  it('should return fresh cached seed nodes', function () {
+    fs.writeFileSync(
+      filename,
+      JSON.stringify({
+        version: 1,
+        entries: {
+          'couchbases://fresh.example.com': {
+            seeds: [['node1.example.com', 11207]],
+            updatedAt: Date.now(),
+          },
+          'couchbases://stale.example.com': {
+            seeds: [['node2.example.com', 11207]],
+            updatedAt: Date.now() - 60000,
+          },
+        },
+      })
+    )
+
+    const cache = new BootstrapCache(filename, 30000)
+    assert.deepStrictEqual(cache.get('couchbases://fresh.example.com'), [
+      ['node1.example.com', 11207],
+    ])
+    assert.isUndefined(cache.get('couchbases://stale.example.com'))
+    assert.isUndefined(cache.get('couchbases://other.example.com'))
+  })
+
+  it('should treat a corrupt cache as empty', function () {
+    fs.writeFileSync(filename, '{not json')
+    const cache = new BootstrapCache(filename, 30000)
+    assert.isUndefined(cache.get('couchbases://fresh.example.com'))
+  })
+})
+
+describe('#packaging', function () {
+  // translates the simple globs used by package.json (*, ** and {a,b})
+  const globToRegExp = (glob) =>
+    new RegExp(
+      '^' +
+        glob
+          .replace(/[.+^$()|[\]\\]/g, '\\$&')
+          .replace(/\{([^}]*)\}/g, (_, alts) => `(${alts.split(',').join('|')})`)
+          .replace(/\*\*\//g, '\0')
+          .replace(/\*/g, '[^/]*')
+          .replace(/\0/g, '(.*/)?') +
+        '$'
+    )
+
+  it('should ship every native source and header', function () {
+    const root = path.join(__dirname, '..')
+    const pkg = JSON.parse(fs.readFileSync(path.join(root, 'package.json'), 'utf8'))
+    const patterns = pkg.files.map(globToRegExp)
+    for (const file of fs.readdirSync(path.join(root, 'src'))) {
+      const relPath = `src/${file}`
+      assert.isTrue(
+        patterns.some((pattern) => pattern.test(relPath)),
+        `${relPath} is not included in the package`
+      )
+    }
+  })
+})
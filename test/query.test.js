@@ -20,19 +20,27 @@
 const { setTimeout } = require('node:timers/promises')
 
 const assert = require('chai').assert
+const fs = require('fs')
+const os = require('os')
+const path = require('path')
 const H = require('./harness')
 
 const {
   QueryMetadata,
+  QueryFieldType,
   QueryMetrics,
   QueryResult,
   QueryScanConsistency,
+  QueryTimings,
 } = require('../lib/querytypes')
 const { Cluster } = require('../lib/cluster')
 const {
   PassthroughDeserializer,
   JsonDeserializer,
+  NativeRowDecoder,
 } = require('../lib/deserializers')
+const { registerRowDecoder } = require('../lib/columnar')
+const { InvalidArgumentError } = require('../lib/errors')
 
 function genericTests(instance) {
   describe('#queryTests', function () {
@@ -105,6 +113,19 @@ function genericTests(instance) {
       assert.isString(passthroughRows.at(0))
     })
 
+    it('should round trip ascii and non-ascii rows', async function () {
+      const values = ['plain ascii', 'x'.repeat(64 * 1024), 'grüße 👋', '']
+      const res = await instance().executeQuery(
+        `FROM $values AS v SELECT VALUE v`,
+        { namedParameters: { values } }
+      )
+      let rows = []
+      for await (const row of res.rows()) {
+        rows.push(row)
+      }
+      assert.deepStrictEqual(rows, values)
+    })
+
     it('should work with multiple options', async function () {
       const results = []
       const qs = `SELECT $five=5`
@@ -126,6 +147,80 @@ function genericTests(instance) {
       assert.isTrue(results.at(0)['$1'])
     })
 
+    it('should decode rows against a schema', async function () {
+      const qs = `FROM RANGE(1, 3) AS i SELECT i AS id, TO_STRING(i) AS name,
+        i > 1 AS big, {"n": [i]} AS extra`
+      const res = await instance().executeQuery(qs, {
+        schema: [
+          { name: 'id', type: QueryFieldType.Number },
+          { name: 'name', type: QueryFieldType.String },
+          { name: 'big', type: QueryFieldType.Boolean },
+          { name: 'extra', type: QueryFieldType.Any },
+        ],
+      })
+      let rows = []
+      for await (const row of res.rows()) {
+        rows.push(row)
+      }
+      assert.deepStrictEqual(rows, [
+        { id: 1, name: '1', big: false, extra: { n: [1] } },
+        { id: 2, name: '2', big: true, extra: { n: [2] } },
+        { id: 3, name: '3', big: true, extra: { n: [3] } },
+      ])
+      rows.forEach((row) =>
+        assert.deepStrictEqual(Object.keys(row), ['id', 'name', 'big', 'extra'])
+      )
+
+      // rows which do not match fall back to the deserializer
+      const fallback = await instance().executeQuery(
+        `FROM RANGE(1, 2) AS i SELECT i AS id, i AS name`,
+        {
+          schema: [
+            { name: 'id', type: QueryFieldType.Number },
+            { name: 'name', type: QueryFieldType.String },
+          ],
+        }
+      )
+      rows = []
+      for await (const row of fallback.rows()) {
+        rows.push(row)
+      }
+      assert.deepStrictEqual(rows, [
+        { id: 1, name: 1 },
+        { id: 2, name: 2 },
+      ])
+    })
+
+    it('should reject invalid schemas', async function () {
+      for (const schema of [
+        [{ name: 'id', type: 'date' }],
+        [
+          { name: 'id', type: QueryFieldType.Number },
+          { name: 'id', type: QueryFieldType.String },
+        ],
+        ['id'],
+      ]) {
+        await H.throwsHelper(async () => {
+          await instance().executeQuery('SELECT 1 AS id', { schema })
+        }, InvalidArgumentError)
+      }
+    })
+
+    it('should reject unregistered native row decoders', async function () {
+      await H.throwsHelper(async () => {
+        await instance().executeQuery('SELECT 1=1', {
+          deserializer: new NativeRowDecoder('missing-decoder'),
+        })
+      }, Error)
+      await H.throwsHelper(async () => {
+        await instance().executeQuery('SELECT 1=1', {
+          deserializer: new NativeRowDecoder('missing-decoder'),
+          bufferedMaxBytes: 1024,
+        })
+      }, InvalidArgumentError)
+      assert.throws(() => registerRowDecoder({}), TypeError)
+    })
+
     it('should should raise error on negative timeout', async function () {
       await H.throwsHelper(async () => {
         await instance().executeQuery("SELECT 'FOO' AS message", {
@@ -150,6 +245,185 @@ function genericTests(instance) {
       assert.isTrue(results.at(0)['$1'])
     })
 
+    it('should serialize structured parameters', async function () {
+      const results = []
+      const qs = `SELECT $1 AS doc, $2 AS ids`
+      const doc = {
+        name: 'quote " and \\ backslash',
+        nested: { values: [1, 2.5, null, undefined], flag: false },
+        skipped: undefined,
+        created: new Date(0),
+        boxed: [new Number(5), new String('ab'), new Boolean(false)],
+      }
+
+      let res = await instance().executeQuery(qs, {
+        positionalParameters: [doc, new Int32Array([1, 2, 3])],
+      })
+
+      for await (const row of res.rows()) {
+        results.push(row)
+      }
+
+      assert.equal(results.length, 1)
+      assert.deepStrictEqual(results.at(0).doc, JSON.parse(JSON.stringify(doc)))
+      assert.deepStrictEqual(results.at(0).ids, [1, 2, 3])
+    })
+
+    it('should accept pre-encoded statements and parameters', async function () {
+      const results = []
+      const qs = Buffer.from(`SELECT $1 AS doc, $2 AS name`)
+
+      let res = await instance().executeQuery(qs, {
+        positionalParameters: [
+          Buffer.from('{"a":[1,2,3]}'),
+          Buffer.from('"columnar"'),
+        ],
+      })
+
+      for await (const row of res.rows()) {
+        results.push(row)
+      }
+
+      assert.equal(results.length, 1)
+      assert.deepStrictEqual(results.at(0).doc, { a: [1, 2, 3] })
+      assert.strictEqual(results.at(0).name, 'columnar')
+    })
+
+    it('should hedge read-only queries', async function () {
+      const qs = `FROM RANGE(1, 10) AS i SELECT *`
+      const res = await instance().executeQuery(qs, {
+        readOnly: true,
+        hedge: true,
+        hedgeDelay: 0,
+      })
+      const results = []
+      for await (const row of res.rows()) {
+        results.push(row)
+      }
+      assert.equal(results.length, 10)
+
+      await H.throwsHelper(async () => {
+        await instance().executeQuery(qs, { hedge: true })
+      }, H.lib.InvalidArgumentError)
+    })
+
+    it('should stream rows through a row ring', async function () {
+      // rows spanning many times the ring size, so that the writer has to wrap
+      // around and wait for the reader
+      const qs = `FROM RANGE(1, 1000) AS i SELECT i, REPEAT('x', 100) AS pad`
+      let res = await instance().executeQuery(qs, { rowRingBufferSize: 4096 })
+      let results = []
+      for await (const row of res.rows()) {
+        results.push(row)
+      }
+      assert.equal(results.length, 1000)
+      assert.deepStrictEqual(
+        results.map((row) => row.i),
+        Array.from({ length: 1000 }, (_, i) => i + 1)
+      )
+      assert.equal(res.metadata().metrics.resultCount, 1000)
+
+      // rows larger than the whole ring
+      res = await instance().executeQuery(
+        `SELECT REPEAT('y', 10000) AS big`,
+        { rowRingBufferSize: 4096 }
+      )
+      results = []
+      for await (const row of res.rows()) {
+        results.push(row)
+      }
+      assert.equal(results.length, 1)
+      assert.equal(results.at(0).big.length, 10000)
+
+      // rows between half and all of the ring, which only fit after a wrap
+      // once the reader has caught up
+      res = await instance().executeQuery(
+        `FROM RANGE(1, 20) AS i SELECT i, REPEAT('z', 1000 + i * 100) AS pad`,
+        { rowRingBufferSize: 4096 }
+      )
+      results = []
+      for await (const row of res.rows()) {
+        results.push(row)
+      }
+      assert.equal(results.length, 20)
+      results.forEach((row, i) => assert.equal(row.pad.length, 1000 + (i + 1) * 100))
+    })
+
+    it('should spill rows to disk for slow consumers', async function () {
+      const directory = fs.mkdtempSync(path.join(os.tmpdir(), 'columnar-'))
+      try {
+        const qs = `FROM RANGE(1, 2000) AS i SELECT *`
+        const res = await instance().executeQuery(qs, {
+          spillToDisk: true,
+          spillDirectory: directory,
+        })
+        // give the rows time to be spilled before consuming them
+        await setTimeout(100)
+        const results = []
+        for await (const row of res.rows()) {
+          results.push(row.i)
+        }
+        assert.deepStrictEqual(
+          results,
+          Array.from({ length: 2000 }, (_, i) => i + 1)
+        )
+        assert.equal(res.metadata().metrics.resultCount, 2000)
+        assert.deepStrictEqual(fs.readdirSync(directory), [])
+      } finally {
+        fs.rmSync(directory, { recursive: true, force: true })
+      }
+    })
+
+    it('should discard rows natively in metadata only mode', async function () {
+      const qs = `FROM RANGE(1, 100) AS i SELECT *`
+      let res = await instance().executeQuery(qs, { metadataOnly: true })
+      // metadata is available without iterating any rows
+      assert.equal(res.metadata().metrics.resultCount, 100)
+      let results = []
+      for await (const row of res.rows()) {
+        results.push(row)
+      }
+      assert.equal(results.length, 0)
+
+      res = await instance().executeQuery(qs, {
+        metadataOnly: true,
+        keepRows: 3,
+      })
+      assert.equal(res.metadata().metrics.resultCount, 100)
+      results = []
+      for await (const row of res.rows()) {
+        results.push(row)
+      }
+      assert.deepStrictEqual(results.map((row) => row.i), [1, 2, 3])
+    })
+
+    it('should deliver small results in a single completion', async function () {
+      const qs = `FROM RANGE(1, 10) AS i SELECT *`
+      let res = await instance().executeQuery(qs, {
+        bufferedMaxBytes: 1024 * 1024,
+      })
+      // the whole result was buffered, so metadata is available up front
+      assert.equal(res.metadata().metrics.resultCount, 10)
+      let results = []
+      for await (const row of res.rows()) {
+        results.push(row)
+      }
+      assert.equal(results.length, 10)
+
+      // results larger than the buffer fall back to streaming
+      res = await instance().executeQuery(`FROM RANGE(1, 1000) AS i SELECT *`, {
+        bufferedMaxBytes: 64,
+      })
+      results = []
+      for await (const row of res.rows()) {
+        results.push(row)
+      }
+      assert.deepStrictEqual(
+        results.map((row) => row.i),
+        Array.from({ length: 1000 }, (_, i) => i + 1)
+      )
+    })
+
     it('should successfully provide query metadata', async function () {
       let results = []
       const qs = `FROM RANGE(1, 100) AS i SELECT *`
@@ -173,6 +447,27 @@ function genericTests(instance) {
       assert.isAbove(metrics.executionTime, 0)
     })
 
+    it('should report client side query timings', async function () {
+      const qs = `FROM RANGE(1, 100) AS i SELECT *`
+      let res = await instance().executeQuery(qs)
+      const early = res.timings()
+      assert.instanceOf(early, QueryTimings)
+      assert.isNumber(early.dispatched)
+      assert.isNumber(early.firstByte)
+      assert.isUndefined(early.finished)
+
+      for await (const row of res.rows()) {
+        assert.isObject(row)
+      }
+
+      const timings = res.metadata().timings
+      assert.instanceOf(timings, QueryTimings)
+      assert.isAtLeast(timings.firstRow, timings.firstByte)
+      assert.isAtLeast(timings.lastRow, timings.firstRow)
+      assert.isAtLeast(timings.finished, timings.lastRow)
+      assert.isAtLeast(timings.jsQueued, 0)
+    })
+
     it('should raise Error when query metadata is unavailable', async function () {
       let results = []
       const qs = `FROM RANGE(1, 100) AS i SELECT *`